@@ -0,0 +1,417 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: bench.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include <cstdlib>
+#include <cstdio>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "generator.h"
+
+#include "../src/log.h"
+#include "../src/emitter.h"
+#include "../src/scanner.h"
+#include "../src/a10/scanner_mapped.h"
+#include "../src/translator.h"
+#include "../src/a10/translator.h"
+#include "../src/a11/translator.h"
+
+#define DEFAULT_REPEAT      5
+#define DEFAULT_TOLERANCE   10
+
+struct Workload
+{
+    const char* name;
+    SourceGenerator::Options options;
+};
+
+struct Measurement
+{
+    double size;
+    u64 tokens;
+    double labelPass;
+    double translationPass;
+    double job;
+    double peakRSS;
+
+    inline double megabytesPerSecond() const { return size / job * 1000.0; }
+    inline double megatokensPerSecond() const { return tokens / job / 1000.0; }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static inline double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// The peak resident set of this address space only. Linux carries the RSS a
+// process had before exec into ru_maxrss, but VmHWM starts over with the new
+// image.
+static double peakRSS()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line))
+        if(line.compare(0, 6, "VmHWM:") == 0)
+            return std::atof(line.c_str() + 6) / 1024.0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+std::vector<Workload> defaultWorkloads(double scale)
+{
+    std::vector<Workload> workloads;
+    Workload workload;
+
+    workload.name = "a10-mixed";
+    workload.options.standard = "a10";
+    workload.options.targetSize = 2 * 1024 * 1024 * scale;
+    workload.options.maxInstructions = 24;
+    workloads.push_back(workload);
+
+    workload = Workload();
+    workload.name = "a11-mixed";
+    workload.options.targetSize = 16 * 1024 * 1024 * scale;
+    workloads.push_back(workload);
+
+    workload = Workload();
+    workload.name = "a11-labels";
+    workload.options.targetSize = 8 * 1024 * 1024 * scale;
+    workload.options.labelDensity = 50;
+    workload.options.mix[SourceGenerator::BRANCH] = 40;
+    workloads.push_back(workload);
+
+    workload = Workload();
+    workload.name = "a11-arithmetic";
+    workload.options.targetSize = 8 * 1024 * 1024 * scale;
+    workload.options.labelDensity = 2;
+    workload.options.mix[SourceGenerator::ARITHMETIC] = 80;
+    workload.options.mix[SourceGenerator::CALL] = 0;
+    workloads.push_back(workload);
+
+    workload = Workload();
+    workload.name = "a11-symbols";
+    workload.options.targetSize = 8 * 1024 * 1024 * scale;
+    workload.options.minInstructions = 2;
+    workload.options.maxInstructions = 12;
+    workload.options.mix[SourceGenerator::GLOBAL] = 40;
+    workload.options.mix[SourceGenerator::CALL] = 40;
+    workloads.push_back(workload);
+
+    return workloads;
+}
+
+u64 countTokens(Log* log, std::string const& path)
+{
+    MappedScannerA10 scanner(log, path);
+    if(!scanner.isOpen()) log->abort("couldn't map \"" + path + "\"");
+
+    u64 tokens = 0;
+    while(scanner.advance())
+        tokens++;
+    return tokens;
+}
+
+Measurement measure(Log* log, Workload const& workload, std::string const& path, unsigned int repeat)
+{
+    std::string output = path + ".aby";
+
+    Measurement best;
+    best.size = 0;
+    best.tokens = countTokens(log, path);
+    best.job = -1;
+
+    for(unsigned int i = 0; i < repeat; i++)
+    {
+        Clock::time_point jobStart = Clock::now();
+
+        MappedScannerA10 scanner(log, path);
+        if(!scanner.isOpen()) log->abort("couldn't map \"" + path + "\"");
+        Emitter emitter;
+
+        std::unique_ptr<Translator> translator;
+        if(workload.options.standard == "a10") translator.reset(new TranslatorA10(log, &scanner, &emitter));
+        else translator.reset(new TranslatorA11(log, &scanner, &emitter));
+
+        Clock::time_point passStart = Clock::now();
+        translator->labelPass();
+        double labelPass = millisecondsSince(passStart);
+
+        scanner.setPosition(0);
+        passStart = Clock::now();
+        translator->translationPass();
+        double translationPass = millisecondsSince(passStart);
+
+        std::ofstream out(output.c_str(), std::ios::out | std::ios::binary);
+        if(!emitter.flush(&out)) log->abort("couldn't write \"" + output + "\"");
+        out.close();
+
+        double job = millisecondsSince(jobStart);
+        if(best.job < 0 || job < best.job)
+        {
+            best.size = (scanner.getBufferEnd() - scanner.getBufferBegin()) / (1024.0 * 1024.0);
+            best.labelPass = labelPass;
+            best.translationPass = translationPass;
+            best.job = job;
+        }
+    }
+
+    std::remove(output.c_str());
+    best.peakRSS = peakRSS();
+    return best;
+}
+
+// Runs measure() in a freshly executed copy of aasm-bench, so the peak RSS
+// covers only the assembler and none of the pages a forked child would share
+// with this process. The child sends its Measurement back over a pipe.
+Measurement measureInChild(Log* log, const char* executable, Workload const& workload, std::string const& path, unsigned int repeat)
+{
+    int fds[2];
+    if(pipe(fds) != 0) log->abort("couldn't create a pipe");
+
+    std::string fd = std::to_string(fds[1]);
+    std::string repeats = std::to_string(repeat);
+    const char* args[] = { executable, "--measure", fd.c_str(), workload.options.standard.c_str(), path.c_str(), repeats.c_str(), 0 };
+
+    std::cout << std::flush;
+    pid_t pid = fork();
+    if(pid < 0) log->abort("couldn't fork");
+    if(pid == 0)
+    {
+        close(fds[0]);
+        execvp(executable, const_cast<char* const*>(args));
+        _exit(EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    Measurement result;
+    ssize_t size = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+
+    int status;
+    if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS || size != sizeof(result))
+        log->abort("workload \"" + std::string(workload.name) + "\" failed");
+    return result;
+}
+
+int measureChild(Log* log, int argc, char** argv)
+{
+    if(argc != 6) log->abort("expected <fd> <standard> <source> <repeat> after --measure");
+    int fd = std::atoi(argv[2]);
+    Workload workload;
+    workload.name = "child";
+    workload.options.standard = argv[3];
+
+    Measurement result = measure(log, workload, argv[4], std::max(1, std::atoi(argv[5])));
+    bool isWritten = write(fd, &result, sizeof(result)) == sizeof(result);
+    close(fd);
+    return isWritten ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+std::map<std::string, double> readBaseline(std::string const& path)
+{
+    std::map<std::string, double> baseline;
+    std::ifstream in(path.c_str());
+    std::string line;
+    while(std::getline(in, line))
+    {
+        if(line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string name;
+        double throughput;
+        if(fields >> name >> throughput) baseline[name] = throughput;
+    }
+    return baseline;
+}
+
+void displayHelp()
+{
+    std::cout << "Usage: aasm-bench [<option>]*\n";
+    std::cout << "Options:\n";
+    std::cout << "  --help                 Display this information\n";
+    std::cout << "  --repeat <n>           Time each workload <n> times and keep the fastest run\n";
+    std::cout << "  --scale <x>            Multiply the size of every workload by <x>\n";
+    std::cout << "  --only <name>          Run only the named workload\n";
+    std::cout << "  --dir <dir>            Write generated sources to <dir>\n";
+    std::cout << "  --baseline <file>      Compare throughput against <file>\n";
+    std::cout << "  --tolerance <pct>      Report regressions slower than the baseline by <pct>\n";
+    std::cout << "  --check                Exit with failure if any workload regressed\n";
+    std::cout << "  --write-baseline <f>   Store the measured throughput and peak RSS in <f>\n";
+    std::cout << "  --generate <file>      Only write a synthetic source to <file>, configured by:\n";
+    std::cout << "    -std<standard>       a10 or a11\n";
+    std::cout << "    -functions <n>       Number of functions\n";
+    std::cout << "    -size <bytes>        Approximate source size, overrides -functions\n";
+    std::cout << "    -instructions <a> <b> Instructions per function, between <a> and <b>\n";
+    std::cout << "    -labels <n>          Labels per 100 instructions\n";
+    std::cout << "    -mix <a> <c> <l> <g> <b> <f> Weights of arithmetic, constant, local,\n";
+    std::cout << "                         global, branch and call instructions\n";
+    std::cout << "    -seed <n>            Random seed\n";
+    std::cout << "\n";
+}
+
+std::string nextArgument(Log* log, int* index, int argc, char** argv)
+{
+    (*index)++;
+    if((*index) >= argc)
+        log->abort("expected argument after " + std::string(argv[*index - 1]));
+    return std::string(argv[*index]);
+}
+
+int main(int argc, char** argv)
+{
+    Log* log = new Log();
+    log->setStream(&std::cout, Log::INFO);
+    log->setStream(&std::cout, Log::WARNING);
+    log->setStream(&std::cerr, Log::ERROR);
+
+    unsigned int repeat = DEFAULT_REPEAT;
+    double scale = 1.0;
+    double tolerance = DEFAULT_TOLERANCE;
+    bool isChecking = false;
+    std::string only = "";
+    std::string directory = ".";
+    std::string baselinePath = "";
+    std::string writeBaselinePath = "";
+    std::string generatePath = "";
+    SourceGenerator::Options options;
+
+    if(argc > 1 && std::string(argv[1]) == "--measure")
+        return measureChild(log, argc, argv);
+
+    for(int argi = 1; argi < argc; argi++)
+    {
+        std::string arg(argv[argi]);
+        if(arg == "--help") { displayHelp(); return EXIT_SUCCESS; }
+        else if(arg == "--repeat") repeat = std::max(1, std::atoi(nextArgument(log, &argi, argc, argv).c_str()));
+        else if(arg == "--scale") scale = std::atof(nextArgument(log, &argi, argc, argv).c_str());
+        else if(arg == "--only") only = nextArgument(log, &argi, argc, argv);
+        else if(arg == "--dir") directory = nextArgument(log, &argi, argc, argv);
+        else if(arg == "--baseline") baselinePath = nextArgument(log, &argi, argc, argv);
+        else if(arg == "--tolerance") tolerance = std::atof(nextArgument(log, &argi, argc, argv).c_str());
+        else if(arg == "--check") isChecking = true;
+        else if(arg == "--write-baseline") writeBaselinePath = nextArgument(log, &argi, argc, argv);
+        else if(arg == "--generate") generatePath = nextArgument(log, &argi, argc, argv);
+        else if(arg == "-stda10" || arg == "-stda11") options.standard = arg.substr(4);
+        else if(arg == "-functions") options.functionc = std::atoi(nextArgument(log, &argi, argc, argv).c_str());
+        else if(arg == "-size") options.targetSize = std::atoll(nextArgument(log, &argi, argc, argv).c_str());
+        else if(arg == "-labels") options.labelDensity = std::atoi(nextArgument(log, &argi, argc, argv).c_str());
+        else if(arg == "-seed") options.seed = std::atoll(nextArgument(log, &argi, argc, argv).c_str());
+        else if(arg == "-instructions")
+        {
+            options.minInstructions = std::atoi(nextArgument(log, &argi, argc, argv).c_str());
+            options.maxInstructions = std::atoi(nextArgument(log, &argi, argc, argv).c_str());
+        }
+        else if(arg == "-mix")
+            for(int i = 0; i < SourceGenerator::MIXC; i++)
+                options.mix[i] = std::atoi(nextArgument(log, &argi, argc, argv).c_str());
+        else log->abort("invalid argument \"" + arg + "\"");
+    }
+
+    if(generatePath != "")
+    {
+        std::string source = SourceGenerator(options).generate();
+        std::ofstream out(generatePath.c_str(), std::ios::out | std::ios::binary);
+        out.write(source.data(), source.size());
+        if(!out.good()) log->abort("couldn't write \"" + generatePath + "\"");
+        return EXIT_SUCCESS;
+    }
+
+    std::map<std::string, double> baseline;
+    if(baselinePath != "") baseline = readBaseline(baselinePath);
+
+    std::ostringstream written;
+    written << "# workload MB/s Mtok/s labelPass translationPass job (ms) RSS (MB)\n";
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-16s %8s %10s %10s %10s %10s %8s %8s %8s %s\n",
+                  "workload", "MB", "tokens", "label ms", "transl ms", "job ms", "MB/s", "Mtok/s", "RSS MB", "baseline");
+    std::cout << line;
+
+    bool isRegressed = false;
+    std::vector<Workload> workloads = defaultWorkloads(scale);
+    for(std::vector<Workload>::iterator workload = workloads.begin(); workload != workloads.end(); workload++)
+    {
+        if(only != "" && only != workload->name) continue;
+
+        std::string path = directory + "/aasm-bench-" + workload->name + ".aml";
+        {
+            std::string source = SourceGenerator(workload->options).generate();
+            std::ofstream out(path.c_str(), std::ios::out | std::ios::binary);
+            out.write(source.data(), source.size());
+            if(!out.good()) log->abort("couldn't write \"" + path + "\"");
+        }
+
+        Measurement result = measureInChild(log, argv[0], *workload, path, repeat);
+        std::remove(path.c_str());
+
+        std::string comparison = "";
+        std::map<std::string, double>::iterator expected = baseline.find(workload->name);
+        if(expected != baseline.end())
+        {
+            double change = (result.megabytesPerSecond() / expected->second - 1.0) * 100.0;
+            char buffer[64];
+            std::snprintf(buffer, sizeof(buffer), "%+.1f%%", change);
+            comparison = buffer;
+            if(change < -tolerance)
+            {
+                comparison += " REGRESSION";
+                isRegressed = true;
+            }
+        }
+
+        std::snprintf(line, sizeof(line), "%-16s %8.2f %10llu %10.2f %10.2f %10.2f %8.1f %8.2f %8.1f %s\n",
+                      workload->name, result.size, (unsigned long long) result.tokens,
+                      result.labelPass, result.translationPass, result.job,
+                      result.megabytesPerSecond(), result.megatokensPerSecond(), result.peakRSS, comparison.c_str());
+        std::cout << line << std::flush;
+
+        std::snprintf(line, sizeof(line), "%s %.1f %.2f %.2f %.2f %.2f %.1f\n",
+                      workload->name, result.megabytesPerSecond(), result.megatokensPerSecond(),
+                      result.labelPass, result.translationPass, result.job, result.peakRSS);
+        written << line;
+    }
+
+    if(writeBaselinePath != "")
+    {
+        std::ofstream out(writeBaselinePath.c_str(), std::ios::out);
+        out << written.str();
+        if(!out.good()) log->abort("couldn't write \"" + writeBaselinePath + "\"");
+    }
+
+    if(isRegressed && isChecking) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: generator.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "generator.h"
+
+#define GLOBALC         64
+#define NATIVEC         8
+#define SAMPLEC         256
+
+static const char* ARITHMETIC_A10[] =
+{
+    "add", "sub", "mul", "div", "rem", "neg", "not", "and", "or", "xor",
+    "lnot", "land", "lor", "shl", "shr", "eq", "ne", "lt", "le", "gt", "ge", "nop"
+};
+
+static const char* ARITHMETIC_A11[] =
+{
+    "addi4", "subi4", "muli4", "divi4", "addi8", "subi8", "muli8", "addf8", "mulf8",
+    "dup4", "dup8", "swap4", "pop4", "pop8", "lnot4", "cmp4", "ci48", "cf84", "nop"
+};
+
+#define COUNT(array)    (sizeof(array) / sizeof(array[0]))
+
+SourceGenerator::Options::Options()
+: standard("a11"), functionc(1000), minInstructions(8), maxInstructions(64),
+  labelDensity(10), targetSize(0), seed(1)
+{
+    mix[ARITHMETIC] = 40;
+    mix[CONSTANT] = 20;
+    mix[LOCAL] = 15;
+    mix[GLOBAL] = 10;
+    mix[BRANCH] = 10;
+    mix[CALL] = 5;
+}
+
+SourceGenerator::SourceGenerator(Options const& options)
+: m_options(options), m_state(options.seed ? options.seed : 1)
+{
+    if(m_options.maxInstructions < m_options.minInstructions)
+        m_options.maxInstructions = m_options.minInstructions;
+}
+
+std::string SourceGenerator::generate()
+{
+    bool isA10 = m_options.standard == "a10";
+    u32 functionc = m_options.functionc ? m_options.functionc : 1;
+    if(m_options.targetSize)
+    {
+        u64 state = m_state;
+        m_out.clear();
+        for(u32 i = 0; i < SAMPLEC; i++)
+            generateFunction(i, SAMPLEC);
+        m_state = state;
+
+        u64 estimate = m_options.targetSize * SAMPLEC / (m_out.size() + 1) + 1;
+        functionc = estimate > 0xFFFF && isA10 ? 0xFFFF : (u32) estimate;
+    }
+
+    m_out.clear();
+    m_out.reserve(m_options.targetSize ? m_options.targetSize * 2 : functionc * 256);
+
+    for(u32 i = 0; i < GLOBALC; i++)
+    {
+        if(isA10) m_out += "w: " + name("g", i) + "\n";
+        else m_out += std::string("w: ") + (i % 2 ? "i8 " : "i4 ") + name("g", i) + "\n";
+    }
+    if(!isA10)
+        for(u32 i = 0; i < NATIVEC; i++)
+            m_out += "n: " + name("native", i) + "\n";
+
+    for(u32 i = 0; i < functionc; i++)
+        generateFunction(i, functionc);
+
+    m_out += isA10 ? "f: main\n  call fn0 0\n  return\n.\n" : "f: main\n  call fn0\n  return\n.\n";
+    return m_out;
+}
+
+SourceGenerator::Mix SourceGenerator::pickMix()
+{
+    u32 total = 0;
+    for(int i = 0; i < MIXC; i++)
+        total += m_options.mix[i];
+
+    u32 pick = below(total);
+    for(int i = 0; i < MIXC; i++)
+    {
+        if(pick < m_options.mix[i]) return (Mix) i;
+        pick -= m_options.mix[i];
+    }
+    return ARITHMETIC;
+}
+
+void SourceGenerator::generateFunction(u32 id, u32 functionc)
+{
+    bool isA10 = m_options.standard == "a10";
+    u32 instructionc = m_options.minInstructions + below(m_options.maxInstructions - m_options.minInstructions + 1);
+    u32 labelc = 1 + instructionc * m_options.labelDensity / 100;
+    u32 localc = 0;
+
+    m_out += "f: " + name("fn", id) + "\n";
+
+    u32 nextLabel = 0;
+    for(u32 i = 0; i < instructionc; i++)
+    {
+        if(nextLabel < labelc && below(instructionc) < labelc)
+            m_out += "  " + name("L", nextLabel++) + ":\n";
+
+        if(isA10) generateInstructionA10(functionc, labelc, &localc);
+        else generateInstructionA11(functionc, labelc, &localc);
+    }
+
+    while(nextLabel < labelc)
+        m_out += "  " + name("L", nextLabel++) + ":\n";
+    m_out += "  return\n.\n";
+}
+
+void SourceGenerator::generateInstructionA10(u32 functionc, u32 labelc, u32* localc)
+{
+    switch(pickMix())
+    {
+    case ARITHMETIC:
+        m_out += std::string("  ") + ARITHMETIC_A10[below(COUNT(ARITHMETIC_A10))] + "\n";
+        break;
+    case CONSTANT:
+        switch(below(3))
+        {
+        case 0: m_out += below(2) ? "  push true\n" : "  push false\n"; break;
+        case 1: m_out += "  push " + std::to_string(below(100000)) + "\n"; break;
+        case 2: m_out += "  push " + std::to_string(below(100000)) + ".25\n"; break;
+        }
+        break;
+    case LOCAL:
+        if(*localc && below(2)) m_out += "  fetch " + name("v", below(*localc)) + "\n";
+        else m_out += "  load " + name("v", (*localc)++) + "\n";
+        break;
+    case GLOBAL:
+        m_out += (below(2) ? "  loadwide " : "  fetchwide ") + name("g", below(GLOBALC)) + "\n";
+        break;
+    case BRANCH:
+        m_out += "  goto " + name("L", below(labelc)) + "\n";
+        break;
+    case CALL:
+        m_out += "  call " + name("fn", below(functionc)) + " " + std::to_string(below(4)) + "\n";
+        break;
+    default: break;
+    }
+}
+
+void SourceGenerator::generateInstructionA11(u32 functionc, u32 labelc, u32* localc)
+{
+    switch(pickMix())
+    {
+    case ARITHMETIC:
+        m_out += std::string("  ") + ARITHMETIC_A11[below(COUNT(ARITHMETIC_A11))] + "\n";
+        break;
+    case CONSTANT:
+        switch(below(3))
+        {
+        case 0: m_out += "  pushi4 " + std::to_string((i32) below(200000) - 100000) + "\n"; break;
+        case 1: m_out += "  pushi8 " + std::to_string(next() >> 16) + "\n"; break;
+        case 2: m_out += "  pushf8 " + std::to_string(below(100000)) + ".25\n"; break;
+        }
+        break;
+    case LOCAL:
+        if(*localc && below(2)) m_out += "  fetch4 " + name("v", below(*localc)) + "\n";
+        else m_out += "  load4 " + name("v", (*localc)++) + "\n";
+        break;
+    case GLOBAL:
+    {
+        u32 global = below(GLOBALC);
+        const char* size = global % 2 ? "8 " : "4 ";
+        m_out += std::string(below(2) ? "  loadwide" : "  fetchwide") + size + name("g", global) + "\n";
+        break;
+    }
+    case BRANCH:
+    {
+        static const char* BRANCHES[] = { "  goto ", "  if ", "  ifn " };
+        m_out += BRANCHES[below(3)] + name("L", below(labelc)) + "\n";
+        break;
+    }
+    case CALL:
+        if(below(4)) m_out += "  call " + name("fn", below(functionc)) + "\n";
+        else m_out += "  native " + name("native", below(NATIVEC)) + "\n";
+        break;
+    default: break;
+    }
+}
@@ -0,0 +1,87 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: generator.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <string>
+
+#include "../src/common.h"
+
+class SourceGenerator
+{
+public:
+    enum Mix
+    {
+        ARITHMETIC,
+        CONSTANT,
+        LOCAL,
+        GLOBAL,
+        BRANCH,
+        CALL,
+
+        MIXC
+    };
+
+    struct Options
+    {
+        std::string standard;
+        u32 functionc;
+        u32 minInstructions;
+        u32 maxInstructions;
+        u32 labelDensity;
+        u32 mix[MIXC];
+        u64 targetSize;
+        u64 seed;
+
+        Options();
+    };
+
+    SourceGenerator(Options const& options);
+
+    std::string generate();
+private:
+    Options m_options;
+    u64 m_state;
+    std::string m_out;
+
+    inline u64 next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
+        return m_state;
+    }
+
+    inline u32 below(u32 bound) { return bound ? next() % bound : 0; }
+
+    inline std::string name(const char* prefix, u32 index) { return prefix + std::to_string(index); }
+
+    Mix pickMix();
+
+    void generateFunction(u32 id, u32 functionc);
+    void generateInstructionA10(u32 functionc, u32 labelc, u32* localc);
+    void generateInstructionA11(u32 functionc, u32 labelc, u32* localc);
+};
+
+#endif /* GENERATOR_H_ */
@@ -35,18 +35,17 @@ public:
     ScannerA10(Log* log, std::istream* in): Scanner(log, in) {}
     ~ScannerA10() {}
 
-    std::string getToken()
-    {
-        return m_token;
-    }
-
     bool nextToken()
     {
-        *m_in >> m_token;
-        return !m_in->eof();
+        *m_in >> m_read;
+        m_token = m_read;
+        return !m_in->fail();
     }
+
+    u64 getPosition() { return m_in->tellg(); }
+    void setPosition(u64 position) { m_in->seekg(position); }
 private:
-    std::string m_token;
+    std::string m_read;
 };
 
 #endif /* SCANNER_A10_H_ */
@@ -0,0 +1,80 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: scanner_mapped.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef SCANNER_MAPPED_A10_H_
+#define SCANNER_MAPPED_A10_H_
+
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../scanner.h"
+
+class MappedScannerA10: public Scanner
+{
+public:
+    MappedScannerA10(Log* log, std::string path)
+    : Scanner(log, 0), m_map(0), m_size(0)
+    {
+        struct stat st;
+        if(stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return;
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return;
+
+        if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            m_size = st.st_size;
+            if(m_size == 0) m_begin = "";
+            else
+            {
+                void* map = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(map != MAP_FAILED)
+                {
+                    madvise(map, m_size, MADV_SEQUENTIAL);
+                    m_map = map;
+                    m_begin = static_cast<const char*>(map);
+                }
+            }
+        }
+        ::close(fd);
+
+        m_cursor = m_begin;
+        m_end = m_begin ? m_begin + m_size : 0;
+    }
+
+    ~MappedScannerA10()
+    {
+        if(m_map) munmap(m_map, m_size);
+    }
+
+    inline bool isOpen() { return m_begin != 0; }
+private:
+    void* m_map;
+    size_t m_size;
+};
+
+#endif /* SCANNER_MAPPED_A10_H_ */
@@ -33,12 +33,13 @@ void TranslatorA10::nativeFunction(std::string name, bool isVoid)
     m_voidNatives.push_back(name);
 }
 
-void TranslatorA10::aspelFunction(std::string name)
+void TranslatorA10::aspelFunction(u16 id)
 {
     m_localvarIDCounter = 0;
     m_localvarIDs.clear();
 
-    passFunction(name);
+    if(m_functions.size() <= id) m_functions.resize(id + 1);
+    passFunction(id);
 }
 
 void TranslatorA10::function()
@@ -58,19 +59,41 @@ void TranslatorA10::function()
     m_scanner->nextTokenEOF();
     std::string name = m_scanner->getToken();
 
-    if(m_functionIDs.find(name) == m_functionIDs.end())
-        m_functionIDs[name] = nextFunctionID();
-    else m_log->abort("function \"" + name + "\" redeclared");
+    if(m_functionIDs.find(name))
+        m_log->abort("function \"" + name + "\" redeclared");
+    u16 id = functionIDFor(name, true);
 
     if(isNative) nativeFunction(name, isVoid);
-    else aspelFunction(name);
+    else aspelFunction(id);
 }
 
 void TranslatorA10::globalvar()
 {
     m_scanner->nextTokenEOF();
-    std::string name = m_scanner->getToken();
-    globalvarIDFor(name, true);
+    globalvarIDFor(m_scanner->token(), true);
+}
+
+u32 TranslatorA10::getOutputSize()
+{
+    u32 size = 6 + 2 + 2 + 2;
+    for(std::vector<std::string>::iterator i = m_nativeFunctions.begin(); i != m_nativeFunctions.end(); i++)
+        size += i->size() + 4;
+    for(u32 i = 0; i < m_functionIDs.size(); i++)
+        if(!isNative(std::string(m_functionIDs.getName(i))))
+            size += 6 + getFunctionSize(m_functionIDs.getValue(i));
+    return size;
+}
+
+std::vector<u32> TranslatorA10::getFunctionsByName()
+{
+    std::vector<u32> functions;
+    for(u32 i = 0; i < m_functionIDs.size(); i++)
+        functions.push_back(i);
+    std::sort(functions.begin(), functions.end(), [this](u32 a, u32 b)
+    {
+        return m_functionIDs.getName(a) < m_functionIDs.getName(b);
+    });
+    return functions;
 }
 
 void TranslatorA10::writeHeader()
@@ -124,31 +147,33 @@ void TranslatorA10::writeFunctionData()
 
     m_filepos += 2 + (functionc - m_nativeFunctions.size())* 6;
 
-    for(std::map<std::string, u32>::iterator i = m_functionIDs.begin(); i != m_functionIDs.end(); i++)
-        if(!isNative(i->first))
+    std::vector<u32> functions = getFunctionsByName();
+    for(std::vector<u32>::iterator i = functions.begin(); i != functions.end(); i++)
+        if(!isNative(std::string(m_functionIDs.getName(*i))))
         {
-            u16 id = i->second;
+            u16 id = m_functionIDs.getValue(*i);
 
             write(&id, 2);
             write(&m_filepos, 4);
-            m_filepos += getFunctionSize(i->first);
+            m_filepos += getFunctionSize(id);
         }
 }
 
 void TranslatorA10::writeFunctions()
 {
-    for(std::map<std::string, u32>::iterator i = m_functionIDs.begin(); i != m_functionIDs.end(); i++)
-        if(!isNative(i->first))
-            writeFunction(i->first);
+    std::vector<u32> functions = getFunctionsByName();
+    for(std::vector<u32>::iterator i = functions.begin(); i != functions.end(); i++)
+        if(!isNative(std::string(m_functionIDs.getName(*i))))
+            writeFunction(m_functionIDs.getValue(*i));
 }
 
 void TranslatorA10::labelPass()
 {
-    while(m_scanner->nextToken())
+    while(m_scanner->advance())
     {
-        std::string token = m_scanner->getToken();
+        std::string_view token = m_scanner->token();
         if(token.length() < 2 || token[1] != ':')
-            m_log->abort("invalid block def \"" + token + "\"");
+            m_log->abort("invalid block def \"" + std::string(token) + "\"");
 
         switch(token[0])
         {
@@ -160,6 +185,8 @@ void TranslatorA10::labelPass()
 
 void TranslatorA10::translationPass()
 {
+    m_out->reserve(m_out->size() + getOutputSize());
+
     writeHeader();
     writeNativeData();
     writeGlobalvarData();
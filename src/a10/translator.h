@@ -25,18 +25,18 @@
 #define TRANSLATOR_A10_H_
 
 #include <string>
-#include <ostream>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <algorithm>
 
 #include "../common.h"
+#include "../symbol_table.h"
 #include "../translator.h"
 
 class TranslatorA10: public Translator
 {
 public:
-    TranslatorA10(Log* log, Scanner* scanner, std::ostream* out)
+    TranslatorA10(Log* log, Scanner* scanner, Emitter* out)
     : Translator(log, scanner, out),
       m_pc(0),
       m_filepos(0),
@@ -50,8 +50,7 @@ public:
 private:
     struct FunctionData
     {
-        std::streampos inpos;
-        std::map<std::string, u32> labels;
+        u64 inpos;
         u32 size;
     };
 
@@ -61,16 +60,17 @@ private:
     u16 m_functionIDCounter;
     u16 m_globalvarIDCounter;
     u16 m_localvarIDCounter;
-    std::map<std::string, u32> m_functionIDs;
-    std::map<std::string, u32> m_globalvarIDs;
-    std::map<std::string, u32> m_localvarIDs;
+    SymbolTable m_functionIDs;
+    SymbolTable m_globalvarIDs;
+    SymbolTable m_localvarIDs;
+    SymbolTable m_labels;
 
-    std::map<std::string, FunctionData> m_functions;
+    std::vector<FunctionData> m_functions;
     std::vector<std::string> m_nativeFunctions;
     std::vector<std::string> m_voidNatives;
 
-    inline void write(void* ptr, size_t size) { m_out->write(reinterpret_cast<const char*>(ptr), size); }
-    inline void writeByte(u8 byte) { m_out->write(reinterpret_cast<const char*>(&byte), 1); }
+    inline void write(const void* ptr, size_t size) { m_out->write(ptr, size); }
+    inline void writeByte(u8 byte) { m_out->writeByte(byte); }
 
     inline u16 nextFunctionID()
     {
@@ -103,43 +103,45 @@ private:
         return std::find(m_voidNatives.begin(), m_voidNatives.end(), name) != m_voidNatives.end();
     }
 
-    inline u16 functionIDFor(std::string name, bool create)
+    inline u16 functionIDFor(std::string_view name, bool create)
     {
-        if(m_functionIDs.find(name) == m_functionIDs.end())
-        {
-            if(create) m_functionIDs[name] = nextFunctionID();
-            else m_log->abort("function \"" + name + "\" not found");
-        }
+        u32* id = m_functionIDs.find(name);
+        if(id) return *id;
 
-        return m_functionIDs[name];
+        if(!create) m_log->abort("function \"" + std::string(name) + "\" not found");
+        u16 value = nextFunctionID();
+        m_functionIDs.set(name, value);
+        return value;
     }
 
-    inline u16 globalvarIDFor(std::string name, bool create)
+    inline u16 globalvarIDFor(std::string_view name, bool create)
     {
-        if(m_globalvarIDs.find(name) == m_globalvarIDs.end())
-        {
-            if(create) m_globalvarIDs[name] = nextFunctionID();
-            else m_log->abort("globalvar \"" + name + "\" not found");
-        }
-        return m_globalvarIDs[name];
+        u32* id = m_globalvarIDs.find(name);
+        if(id) return *id;
+
+        if(!create) m_log->abort("globalvar \"" + std::string(name) + "\" not found");
+        u16 value = nextFunctionID();
+        m_globalvarIDs.set(name, value);
+        return value;
     }
 
-    inline u16 localvarIDFor(std::string name, bool create)
+    inline u16 localvarIDFor(std::string_view name, bool create)
     {
-        if(m_localvarIDs.find(name) == m_localvarIDs.end())
-        {
-            if(create) m_localvarIDs[name] = nextFunctionID();
-            else m_log->abort("var \"" + name + "\" not found");
-        }
-        return m_localvarIDs[name];
+        u32* id = m_localvarIDs.find(name);
+        if(id) return *id;
+
+        if(!create) m_log->abort("var \"" + std::string(name) + "\" not found");
+        u16 value = nextFunctionID();
+        m_localvarIDs.set(name, value);
+        return value;
     }
 
-    inline bool isBoolean(std::string s)
+    inline bool isBoolean(std::string_view s)
     {
         return s == "true" || s == "false";
     }
 
-    inline bool isInteger(std::string s)
+    inline bool isInteger(std::string_view s)
     {
         for(unsigned int i = 0; i < s.size(); i++)
             if(s[i] < '0' || s[i] > '9')
@@ -147,7 +149,7 @@ private:
         return true;
     }
 
-    inline bool isFloat(std::string s)
+    inline bool isFloat(std::string_view s)
     {
         bool decpoint = false;
         for(unsigned int i = 0; i < s.size(); i++)
@@ -159,16 +161,20 @@ private:
         return true;
     }
 
-    void passFunction(std::string name);
-    u32 getFunctionSize(std::string name);
-    u32 getLabelPC(std::string functionName, std::string labelName);
-    void writeFunction(std::string name);
+    std::vector<u32> getFunctionsByName();
+
+    void passFunction(u16 id);
+    u32 getFunctionSize(u16 id);
+    u32 getLabelPC(u16 id, std::string_view labelName);
+    void writeFunction(u16 id);
 
     void nativeFunction(std::string name, bool isVoid);
-    void aspelFunction(std::string name);
+    void aspelFunction(u16 id);
     void function();
     void globalvar();
 
+    u32 getOutputSize();
+
     void writeHeader();
     void writeNativeData();
     void writeGlobalvarData();
@@ -64,22 +64,22 @@
 #define CALL_CODE       0x53
 #define RETURN_CODE     0x54
 
-void TranslatorA10::passFunction(std::string name)
+void TranslatorA10::passFunction(u16 id)
 {
     m_pc = 0;
-    m_functions[name].inpos = m_scanner->getIn()->tellg();
-    m_functions[name].labels.clear();
+    FunctionData& function = m_functions[id];
+    function.inpos = m_scanner->getPosition();
 
     while(true)
     {
         m_scanner->nextTokenEOF();
-        std::string token = m_scanner->getToken();
+        std::string_view token = m_scanner->token();
 
         if(token == ".") break;
 
         if(token[token.size() - 1] == ':')
         {
-            m_functions[name].labels[token.substr(0, token.size() - 1)] = m_pc;
+            m_labels.set(token.substr(0, token.size() - 1), m_pc, id);
             continue;
         }
 
@@ -87,7 +87,7 @@ void TranslatorA10::passFunction(std::string name)
         if(token == "push")
         {
             m_scanner->nextTokenEOF();
-            std::string value = m_scanner->getToken();
+            std::string_view value = m_scanner->token();
             if(isBoolean(value)) { m_pc++; }
             else if(isInteger(value)) { m_pc += 8; }
             else if(isFloat(value)) { m_pc += 8; }
@@ -95,46 +95,48 @@ void TranslatorA10::passFunction(std::string name)
         }
         else
         {
-            if(token == "load" || token == "loadwide" || token == "fetch" || token == "fetchwide"
-            || token == "if" || token == "ifn" || token == "goto" || token == "call")
+            bool isBranch = token == "if" || token == "ifn" || token == "goto" || token == "call";
+            bool isVariable = token == "load" || token == "loadwide" || token == "fetch" || token == "fetchwide";
+            if(isBranch || isVariable)
             {
                 m_pc += 2;
-                if(token == "if" || token == "ifn" || token == "goto" || token == "call")
+                if(isBranch)
                     m_pc += 2;
 
-                if(token == "load" || token == "loadwide" || token == "fetch" || token == "fetchwide" || token == "goto" || token == "call")
+                if(isVariable || token == "goto" || token == "call")
                 {
+                    bool isCall = token == "call";
                     m_scanner->nextTokenEOF();
-                    if(token == "call")
+                    if(isCall)
                         m_scanner->nextTokenEOF();
                 }
             }
         }
     }
 
-    m_functions[name].size = m_pc;
+    function.size = m_pc;
 }
 
-u32 TranslatorA10::getFunctionSize(std::string name)
+u32 TranslatorA10::getFunctionSize(u16 id)
 {
-    return m_functions[name].size;
+    return m_functions[id].size;
 }
 
-u32 TranslatorA10::getLabelPC(std::string functionName, std::string labelName)
+u32 TranslatorA10::getLabelPC(u16 id, std::string_view labelName)
 {
-    FunctionData fdat = m_functions[functionName];
-    if(fdat.labels.find(labelName) == fdat.labels.end())
-        m_log->abort("label \"" + labelName + "\" not found");
-    return fdat.labels[labelName];
+    u32* pc = m_labels.find(labelName, id);
+    if(!pc)
+        m_log->abort("label \"" + std::string(labelName) + "\" not found");
+    return *pc;
 }
 
-void TranslatorA10::writeFunction(std::string name)
+void TranslatorA10::writeFunction(u16 id)
 {
-    m_scanner->getIn()->seekg(m_functions[name].inpos);
+    m_scanner->setPosition(m_functions[id].inpos);
     while(true)
     {
         m_scanner->nextTokenEOF();
-        std::string token = m_scanner->getToken();
+        std::string_view token = m_scanner->token();
         if(token == ".") break;
 
         if(token[token.size() - 1] == ':') continue;
@@ -142,17 +144,17 @@ void TranslatorA10::writeFunction(std::string name)
         if(token == "push")
         {
             m_scanner->nextTokenEOF();
-            std::string strval = m_scanner->getToken();
+            std::string_view strval = m_scanner->token();
             if(isBoolean(strval)) { writeByte(PUSHB_CODE); writeByte(strval == "true" ? 0x01 : 0x00); continue; }
-            if(isInteger(strval)) { writeByte(PUSHI_CODE); long value = std::atol(strval.c_str()); write(&value, 8); continue; }
-            if(isFloat(strval)) { writeByte(PUSHF_CODE); double value = std::atof(strval.c_str()); write(&value, 8); continue; }
+            if(isInteger(strval)) { writeByte(PUSHI_CODE); i64 value = parseInteger(strval); write(&value, 8); continue; }
+            if(isFloat(strval)) { writeByte(PUSHF_CODE); f64 value = parseFloat(strval); write(&value, 8); continue; }
             m_log->abort("unknown push type");
         }
         if(token == "load")
         {
             writeByte(LOAD_CODE);
             m_scanner->nextTokenEOF();
-            u16 id = localvarIDFor(m_scanner->getToken(), true);
+            u16 id = localvarIDFor(m_scanner->token(), true);
             write(&id, 2);
             continue;
         }
@@ -160,7 +162,7 @@ void TranslatorA10::writeFunction(std::string name)
         {
             writeByte(LOADWIDE_CODE);
             m_scanner->nextTokenEOF();
-            u16 id = globalvarIDFor(m_scanner->getToken(), true);
+            u16 id = globalvarIDFor(m_scanner->token(), true);
             write(&id, 2);
             continue;
         }
@@ -168,7 +170,7 @@ void TranslatorA10::writeFunction(std::string name)
         {
             writeByte(FETCH_CODE);
             m_scanner->nextTokenEOF();
-            u16 id = localvarIDFor(m_scanner->getToken(), false);
+            u16 id = localvarIDFor(m_scanner->token(), false);
             write(&id, 2);
             continue;
         }
@@ -176,7 +178,7 @@ void TranslatorA10::writeFunction(std::string name)
         {
             writeByte(FETCHWIDE_CODE);
             m_scanner->nextTokenEOF();
-            u16 id = globalvarIDFor(m_scanner->getToken(), false);
+            u16 id = globalvarIDFor(m_scanner->token(), false);
             write(&id, 2);
             continue;
         }
@@ -206,35 +208,35 @@ void TranslatorA10::writeFunction(std::string name)
             writeByte(IF_CODE);
             m_scanner->nextTokenEOF();
             m_scanner->nextTokenEOF();
-            u32 pc = getLabelPC(name, m_scanner->getToken()); write(&pc, 4);
+            u32 pc = getLabelPC(id, m_scanner->token()); write(&pc, 4);
             continue;
         }
         if(token == "ifn")
         {
             writeByte(IFN_CODE);
             m_scanner->nextTokenEOF();
-            u32 pc = getLabelPC(name, m_scanner->getToken()); write(&pc, 4);
+            u32 pc = getLabelPC(id, m_scanner->token()); write(&pc, 4);
             continue;
         }
         if(token == "goto")
         {
             writeByte(GOTO_CODE);
             m_scanner->nextTokenEOF();
-            u32 pc = getLabelPC(name, m_scanner->getToken()); write(&pc, 4);
+            u32 pc = getLabelPC(id, m_scanner->token()); write(&pc, 4);
             continue;
         }
         if(token == "call")
         {
             writeByte(CALL_CODE);
             m_scanner->nextTokenEOF();
-            u16 id = functionIDFor(m_scanner->getToken(), false);
+            u16 callee = functionIDFor(m_scanner->token(), false);
             m_scanner->nextTokenEOF();
-            u8 argc = (u8) std::atoi(m_scanner->getToken().c_str());
-            write(&id, 2);
+            u8 argc = (u8) parseInteger(m_scanner->token());
+            write(&callee, 2);
             write(&argc, 1);
             continue;
         }
         if(token == "return") { writeByte(RETURN_CODE); continue; }
-        m_log->abort("unrecognized mnemonic \"" + token + "\"");
+        m_log->abort("unrecognized mnemonic \"" + std::string(token) + "\"");
     }
 }
@@ -0,0 +1,240 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: instructions.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "instructions.h"
+
+#include <cstring>
+
+static const InstructionA11 INSTRUCTIONS[] =
+{
+    { "nop",        OP_NOP,         OPERAND_NONE,      0, 0 },
+    { "pushi4",     OP_PUSH4,       OPERAND_INT4,      4, 0 },
+    { "pushi8",     OP_PUSH8,       OPERAND_INT8,      8, 0 },
+    { "pushf4",     OP_PUSH4,       OPERAND_FLOAT4,    4, 0 },
+    { "pushf8",     OP_PUSH8,       OPERAND_FLOAT8,    8, 0 },
+    { "pop4",       OP_POP4,        OPERAND_NONE,      0, 0 },
+    { "pop8",       OP_POP8,        OPERAND_NONE,      0, 0 },
+    { "load4",      OP_LOAD4,       OPERAND_LVAR_DEF,  4, 4 },
+    { "load8",      OP_LOAD8,       OPERAND_LVAR_DEF,  4, 8 },
+    { "fetch4",     OP_FETCH4,      OPERAND_LVAR,      4, 4 },
+    { "fetch8",     OP_FETCH8,      OPERAND_LVAR,      4, 8 },
+    { "loadwide4",  OP_LOADWIDE4,   OPERAND_GVAR_DEF,  4, 4 },
+    { "loadwide8",  OP_LOADWIDE8,   OPERAND_GVAR_DEF,  4, 8 },
+    { "fetchwide4", OP_FETCHWIDE4,  OPERAND_GVAR,      4, 4 },
+    { "fetchwide8", OP_FETCHWIDE8,  OPERAND_GVAR,      4, 8 },
+    { "varptr",     OP_VARPTR,      OPERAND_LVAR,      4, 4 },
+    { "varptrwide", OP_VARPTRWIDE,  OPERAND_GVAR,      4, 4 },
+    { "alloc",      OP_ALLOC,       OPERAND_NONE,      0, 0 },
+    { "free",       OP_FREE,        OPERAND_NONE,      0, 0 },
+    { "refl1",      OP_REFL1,       OPERAND_NONE,      0, 0 },
+    { "refl2",      OP_REFL2,       OPERAND_NONE,      0, 0 },
+    { "refl4",      OP_REFL4,       OPERAND_NONE,      0, 0 },
+    { "refl8",      OP_REFL8,       OPERAND_NONE,      0, 0 },
+    { "extr1",      OP_EXTR1,       OPERAND_NONE,      0, 0 },
+    { "extr2",      OP_EXTR2,       OPERAND_NONE,      0, 0 },
+    { "extr4",      OP_EXTR4,       OPERAND_NONE,      0, 0 },
+    { "extr8",      OP_EXTR8,       OPERAND_NONE,      0, 0 },
+    { "swap4",      OP_SWAP4,       OPERAND_NONE,      0, 0 },
+    { "swap8",      OP_SWAP8,       OPERAND_NONE,      0, 0 },
+    { "swap48",     OP_SWAP48,      OPERAND_NONE,      0, 0 },
+    { "swap84",     OP_SWAP84,      OPERAND_NONE,      0, 0 },
+    { "dup4",       OP_DUP4,        OPERAND_NONE,      0, 0 },
+    { "dup8",       OP_DUP8,        OPERAND_NONE,      0, 0 },
+    { "addi4",      OP_ADDI4,       OPERAND_NONE,      0, 0 },
+    { "addi8",      OP_ADDI8,       OPERAND_NONE,      0, 0 },
+    { "addf4",      OP_ADDF4,       OPERAND_NONE,      0, 0 },
+    { "addf8",      OP_ADDF8,       OPERAND_NONE,      0, 0 },
+    { "subi4",      OP_SUBI4,       OPERAND_NONE,      0, 0 },
+    { "subi8",      OP_SUBI8,       OPERAND_NONE,      0, 0 },
+    { "subf4",      OP_SUBF4,       OPERAND_NONE,      0, 0 },
+    { "subf8",      OP_SUBF8,       OPERAND_NONE,      0, 0 },
+    { "muli4",      OP_MULI4,       OPERAND_NONE,      0, 0 },
+    { "muli8",      OP_MULI8,       OPERAND_NONE,      0, 0 },
+    { "mulf4",      OP_MULF4,       OPERAND_NONE,      0, 0 },
+    { "mulf8",      OP_MULF8,       OPERAND_NONE,      0, 0 },
+    { "divi4",      OP_DIVI4,       OPERAND_NONE,      0, 0 },
+    { "divi8",      OP_DIVI8,       OPERAND_NONE,      0, 0 },
+    { "divu4",      OP_DIVU4,       OPERAND_NONE,      0, 0 },
+    { "divu8",      OP_DIVU8,       OPERAND_NONE,      0, 0 },
+    { "divf4",      OP_DIVF4,       OPERAND_NONE,      0, 0 },
+    { "divf8",      OP_DIVF8,       OPERAND_NONE,      0, 0 },
+    { "remi4",      OP_REMI4,       OPERAND_NONE,      0, 0 },
+    { "remi8",      OP_REMI8,       OPERAND_NONE,      0, 0 },
+    { "remu4",      OP_REMU4,       OPERAND_NONE,      0, 0 },
+    { "remu8",      OP_REMU8,       OPERAND_NONE,      0, 0 },
+    { "negi4",      OP_NEGI4,       OPERAND_NONE,      0, 0 },
+    { "negi8",      OP_NEGI8,       OPERAND_NONE,      0, 0 },
+    { "negf4",      OP_NEGF4,       OPERAND_NONE,      0, 0 },
+    { "negf8",      OP_NEGF8,       OPERAND_NONE,      0, 0 },
+    { "shl4",       OP_SHL4,        OPERAND_NONE,      0, 0 },
+    { "shl8",       OP_SHL8,        OPERAND_NONE,      0, 0 },
+    { "shr4",       OP_SHR4,        OPERAND_NONE,      0, 0 },
+    { "shr8",       OP_SHR8,        OPERAND_NONE,      0, 0 },
+    { "shru4",      OP_SHRU4,       OPERAND_NONE,      0, 0 },
+    { "shru8",      OP_SHRU8,       OPERAND_NONE,      0, 0 },
+    { "bnot4",      OP_BNOT4,       OPERAND_NONE,      0, 0 },
+    { "bnot8",      OP_BNOT8,       OPERAND_NONE,      0, 0 },
+    { "band4",      OP_BAND4,       OPERAND_NONE,      0, 0 },
+    { "band8",      OP_BAND8,       OPERAND_NONE,      0, 0 },
+    { "bxor4",      OP_BXOR4,       OPERAND_NONE,      0, 0 },
+    { "bxor8",      OP_BXOR8,       OPERAND_NONE,      0, 0 },
+    { "bor4",       OP_BOR4,        OPERAND_NONE,      0, 0 },
+    { "bor8",       OP_BOR8,        OPERAND_NONE,      0, 0 },
+    { "lnot4",      OP_LNOT4,       OPERAND_NONE,      0, 0 },
+    { "lnot8",      OP_LNOT8,       OPERAND_NONE,      0, 0 },
+    { "land4",      OP_LAND4,       OPERAND_NONE,      0, 0 },
+    { "land8",      OP_LAND8,       OPERAND_NONE,      0, 0 },
+    { "lor4",       OP_LOR4,        OPERAND_NONE,      0, 0 },
+    { "lor8",       OP_LOR8,        OPERAND_NONE,      0, 0 },
+    { "ci14",       OP_CI14,        OPERAND_NONE,      0, 0 },
+    { "ci24",       OP_CI24,        OPERAND_NONE,      0, 0 },
+    { "ci41",       OP_CI41,        OPERAND_NONE,      0, 0 },
+    { "ci42",       OP_CI42,        OPERAND_NONE,      0, 0 },
+    { "ci48",       OP_CI48,        OPERAND_NONE,      0, 0 },
+    { "ci84",       OP_CI84,        OPERAND_NONE,      0, 0 },
+    { "cf48",       OP_CF48,        OPERAND_NONE,      0, 0 },
+    { "cf84",       OP_CF84,        OPERAND_NONE,      0, 0 },
+    { "cfi4",       OP_CFI4,        OPERAND_NONE,      0, 0 },
+    { "cfi8",       OP_CFI8,        OPERAND_NONE,      0, 0 },
+    { "cif4",       OP_CIF4,        OPERAND_NONE,      0, 0 },
+    { "cif8",       OP_CIF8,        OPERAND_NONE,      0, 0 },
+    { "goto",       OP_GOTO,        OPERAND_LABEL,     4, 0 },
+    { "if",         OP_IF,          OPERAND_LABEL,     4, 0 },
+    { "ifn",        OP_IFN,         OPERAND_LABEL,     4, 0 },
+    { "ltnl",       OP_LTNL,        OPERAND_NONE,      0, 0 },
+    { "lenl",       OP_LENL,        OPERAND_NONE,      0, 0 },
+    { "gtnl",       OP_GTNL,        OPERAND_NONE,      0, 0 },
+    { "genl",       OP_GENL,        OPERAND_NONE,      0, 0 },
+    { "eqnl",       OP_EQNL,        OPERAND_NONE,      0, 0 },
+    { "nenl",       OP_NENL,        OPERAND_NONE,      0, 0 },
+    { "cmp4",       OP_CMP4,        OPERAND_NONE,      0, 0 },
+    { "cmp8",       OP_CMP8,        OPERAND_NONE,      0, 0 },
+    { "icmp4",      OP_ICMP4,       OPERAND_NONE,      0, 0 },
+    { "icmp8",      OP_ICMP8,       OPERAND_NONE,      0, 0 },
+    { "iucmp4",     OP_IUCMP4,      OPERAND_NONE,      0, 0 },
+    { "iucmp8",     OP_IUCMP8,      OPERAND_NONE,      0, 0 },
+    { "iucmpr4",    OP_IUCMPR4,     OPERAND_NONE,      0, 0 },
+    { "iucmpr8",    OP_IUCMPR8,     OPERAND_NONE,      0, 0 },
+    { "fcmp4",      OP_FCMP4,       OPERAND_NONE,      0, 0 },
+    { "fcmp8",      OP_FCMP8,       OPERAND_NONE,      0, 0 },
+    { "ficmp4",     OP_FICMP4,      OPERAND_NONE,      0, 0 },
+    { "ficmp8",     OP_FICMP8,      OPERAND_NONE,      0, 0 },
+    { "ficmpr4",    OP_FICMPR4,     OPERAND_NONE,      0, 0 },
+    { "ficmpr8",    OP_FICMPR8,     OPERAND_NONE,      0, 0 },
+    { "fucmp4",     OP_FUCMP4,      OPERAND_NONE,      0, 0 },
+    { "fucmp8",     OP_FUCMP8,      OPERAND_NONE,      0, 0 },
+    { "fucmpr4",    OP_FUCMPR4,     OPERAND_NONE,      0, 0 },
+    { "fucmpr8",    OP_FUCMPR8,     OPERAND_NONE,      0, 0 },
+    { "call",       OP_CALL,        OPERAND_FUNCTION,  4, 0 },
+    { "return",     OP_RETURN,      OPERAND_NONE,      0, 0 },
+    { "native",     OP_NATIVE,      OPERAND_NATIVE,    4, 0 },
+};
+
+#define INSTRUCTIONC    (sizeof(INSTRUCTIONS) / sizeof(INSTRUCTIONS[0]))
+#define HASH_BITS       11
+#define HASH_SIZE       (1 << HASH_BITS)
+#define HASH_EMPTY      0xFF
+
+static inline u32 hashMnemonic(const char* str, size_t length, u32 seed)
+{
+    u32 hash = 2166136261u ^ seed;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= (u8) str[i];
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+    return hash & (HASH_SIZE - 1);
+}
+
+class InstructionTableA11
+{
+public:
+    InstructionTableA11()
+    {
+        for(m_seed = 0; !tryBuild(); m_seed++);
+
+        std::memset(m_opcodes, HASH_EMPTY, sizeof(m_opcodes));
+        for(u32 i = 0; i < INSTRUCTIONC; i++)
+            if(m_opcodes[INSTRUCTIONS[i].opcode] == HASH_EMPTY)
+                m_opcodes[INSTRUCTIONS[i].opcode] = i;
+    }
+
+    inline const InstructionA11* find(u8 opcode) const
+    {
+        u8 index = m_opcodes[opcode];
+        return index == HASH_EMPTY ? 0 : &INSTRUCTIONS[index];
+    }
+
+    inline const InstructionA11* find(const char* str, size_t length) const
+    {
+        u8 index = m_slots[hashMnemonic(str, length, m_seed)];
+        if(index == HASH_EMPTY) return 0;
+        const InstructionA11* instruction = &INSTRUCTIONS[index];
+        if(std::strncmp(instruction->mnemonic, str, length) != 0 || instruction->mnemonic[length] != 0)
+            return 0;
+        return instruction;
+    }
+private:
+    u32 m_seed;
+    u8 m_slots[HASH_SIZE];
+    u8 m_opcodes[256];
+
+    bool tryBuild()
+    {
+        std::memset(m_slots, HASH_EMPTY, sizeof(m_slots));
+        for(u32 i = 0; i < INSTRUCTIONC; i++)
+        {
+            const char* mnemonic = INSTRUCTIONS[i].mnemonic;
+            u32 slot = hashMnemonic(mnemonic, std::strlen(mnemonic), m_seed);
+            if(m_slots[slot] != HASH_EMPTY) return false;
+            m_slots[slot] = i;
+        }
+        return true;
+    }
+};
+
+// Built on first use, so translators constructed during static initialisation
+// in other translation units never see an empty table.
+static inline const InstructionTableA11& instructionTable()
+{
+    static const InstructionTableA11 table;
+    return table;
+}
+
+const InstructionA11* findInstructionA11(const char* mnemonic, size_t length)
+{
+    return instructionTable().find(mnemonic, length);
+}
+
+const InstructionA11* findInstructionA11(const char* mnemonic)
+{
+    return instructionTable().find(mnemonic, std::strlen(mnemonic));
+}
+
+const InstructionA11* findInstructionA11(u8 opcode)
+{
+    return instructionTable().find(opcode);
+}
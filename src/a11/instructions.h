@@ -0,0 +1,196 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: instructions.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef INSTRUCTIONS_A11_H_
+#define INSTRUCTIONS_A11_H_
+
+#include <cstddef>
+
+#include "../common.h"
+
+#define OP_NOP          0x00
+#define OP_PUSH4        0x08
+#define OP_PUSH8        0x09
+#define OP_POP4         0x0C
+#define OP_POP8         0x0D
+
+#define OP_LOAD4        0x10
+#define OP_LOAD8        0x11
+#define OP_LOADWIDE4    0x12
+#define OP_LOADWIDE8    0x13
+#define OP_FETCH4       0x18
+#define OP_FETCH8       0x19
+#define OP_FETCHWIDE4   0x1A
+#define OP_FETCHWIDE8   0x1B
+#define OP_VARPTR       0x1C
+#define OP_VARPTRWIDE   0x1D
+
+#define OP_ALLOC        0x20
+#define OP_FREE         0x21
+
+#define OP_REFL1        0x30
+#define OP_REFL2        0x31
+#define OP_REFL4        0x32
+#define OP_REFL8        0x33
+#define OP_EXTR1        0x38
+#define OP_EXTR2        0x39
+#define OP_EXTR4        0x3A
+#define OP_EXTR8        0x3B
+
+#define OP_SWAP4        0x40
+#define OP_SWAP8        0x41
+#define OP_SWAP48       0x42
+#define OP_SWAP84       0x43
+#define OP_DUP4         0x48
+#define OP_DUP8         0x49
+
+#define OP_ADDI4        0x50
+#define OP_ADDI8        0x51
+#define OP_ADDF4        0x52
+#define OP_ADDF8        0x53
+#define OP_SUBI4        0x54
+#define OP_SUBI8        0x55
+#define OP_SUBF4        0x56
+#define OP_SUBF8        0x57
+#define OP_MULI4        0x58
+#define OP_MULI8        0x59
+#define OP_MULF4        0x5A
+#define OP_MULF8        0x5B
+#define OP_DIVI4        0x5C
+#define OP_DIVI8        0x5D
+#define OP_DIVU4        0x5E
+#define OP_DIVU8        0x5F
+#define OP_DIVF4        0x60
+#define OP_DIVF8        0x61
+#define OP_REMI4        0x62
+#define OP_REMI8        0x63
+#define OP_REMU4        0x64
+#define OP_REMU8        0x65
+#define OP_NEGI4        0x66
+#define OP_NEGI8        0x67
+#define OP_NEGF4        0x68
+#define OP_NEGF8        0x69
+
+#define OP_SHL4         0x80
+#define OP_SHL8         0x81
+#define OP_SHR4         0x82
+#define OP_SHR8         0x83
+#define OP_SHRU4        0x84
+#define OP_SHRU8        0x85
+#define OP_BNOT4        0x86
+#define OP_BNOT8        0x87
+#define OP_BAND4        0x88
+#define OP_BAND8        0x89
+#define OP_BXOR4        0x8A
+#define OP_BXOR8        0x8B
+#define OP_BOR4         0x8C
+#define OP_BOR8         0x8D
+
+#define OP_LNOT4        0xA0
+#define OP_LNOT8        0xA1
+#define OP_LAND4        0xA2
+#define OP_LAND8        0xA3
+#define OP_LOR4         0xA4
+#define OP_LOR8         0xA5
+
+#define OP_CI14         0xB0
+#define OP_CI24         0xB1
+#define OP_CI41         0xB2
+#define OP_CI42         0xB3
+#define OP_CI48         0xB4
+#define OP_CI84         0xB5
+#define OP_CF48         0xB6
+#define OP_CF84         0xB7
+#define OP_CFI4         0xB8
+#define OP_CFI8         0xB9
+#define OP_CIF4         0xBA
+#define OP_CIF8         0xBB
+
+#define OP_GOTO         0xD0
+#define OP_CALL         0xD1
+#define OP_RETURN       0xD2
+#define OP_NATIVE       0xD3
+#define OP_IF           0xD4
+#define OP_IFN          0xD5
+#define OP_LTNL         0xDA
+#define OP_LENL         0xDB
+#define OP_GTNL         0xDC
+#define OP_GENL         0xDD
+#define OP_EQNL         0xDE
+#define OP_NENL         0xDF
+
+#define OP_CMP4         0xE0
+#define OP_CMP8         0xE1
+#define OP_ICMP4        0xE2
+#define OP_ICMP8        0xE3
+#define OP_IUCMP4       0xE4
+#define OP_IUCMP8       0xE5
+#define OP_IUCMPR4      0xE6
+#define OP_IUCMPR8      0xE7
+#define OP_FCMP4        0xE8
+#define OP_FCMP8        0xE9
+#define OP_FICMP4       0xEA
+#define OP_FICMP8       0xEB
+#define OP_FICMPR4      0xEC
+#define OP_FICMPR8      0xED
+#define OP_FUCMP4       0xEE
+#define OP_FUCMP8       0xEF
+#define OP_FUCMPR4      0xF1
+#define OP_FUCMPR8      0xF2
+
+enum OperandA11
+{
+    OPERAND_NONE,
+    OPERAND_INT4,
+    OPERAND_INT8,
+    OPERAND_FLOAT4,
+    OPERAND_FLOAT8,
+    OPERAND_LVAR,
+    OPERAND_LVAR_DEF,
+    OPERAND_GVAR,
+    OPERAND_GVAR_DEF,
+    OPERAND_LABEL,
+    OPERAND_FUNCTION,
+    OPERAND_NATIVE
+};
+
+struct InstructionA11
+{
+    const char* mnemonic;
+    u8 opcode;
+    OperandA11 operand;
+    u8 width;
+    u8 varSize;
+};
+
+const InstructionA11* findInstructionA11(const char* mnemonic, size_t length);
+const InstructionA11* findInstructionA11(const char* mnemonic);
+const InstructionA11* findInstructionA11(u8 opcode);
+
+inline bool isControlFlowA11(u8 opcode)
+{
+    return opcode == OP_GOTO || opcode == OP_IF || opcode == OP_IFN
+        || opcode == OP_CALL || opcode == OP_RETURN || opcode == OP_NATIVE;
+}
+
+#endif /* INSTRUCTIONS_A11_H_ */
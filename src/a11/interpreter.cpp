@@ -0,0 +1,506 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: interpreter.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "interpreter.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "semantics.h"
+#include "translator.h"
+
+class Reader
+{
+public:
+    Reader(Log* log, const u8* data, size_t size): m_log(log), m_data(data), m_size(size), m_position(0) {}
+
+    inline size_t getPosition() { return m_position; }
+    inline bool isEnd() { return m_position >= m_size; }
+
+    inline void read(void* ptr, size_t size)
+    {
+        if(m_size - m_position < size) m_log->abort("unexpected end of bytecode");
+        std::memcpy(ptr, m_data + m_position, size);
+        m_position += size;
+    }
+
+    inline void skip(size_t size)
+    {
+        if(m_size - m_position < size) m_log->abort("unexpected end of bytecode");
+        m_position += size;
+    }
+
+    inline u8 readByte() { u8 value; read(&value, 1); return value; }
+    inline u32 read4() { u32 value; read(&value, 4); return value; }
+    inline u64 read8() { u64 value; read(&value, 8); return value; }
+
+    inline u64 readVarint()
+    {
+        u64 value = 0;
+        for(u32 shift = 0; shift < 64; shift += 7)
+        {
+            u8 byte = readByte();
+            value |= (u64) (byte & 0x7F) << shift;
+            if(!(byte & 0x80)) return value;
+        }
+        m_log->abort("invalid varint in bytecode");
+        return 0;
+    }
+
+    inline std::string readString()
+    {
+        std::string value;
+        for(u8 c = readByte(); c; c = readByte())
+            value += (char) c;
+        return value;
+    }
+private:
+    Log* m_log;
+    const u8* m_data;
+    size_t m_size;
+    size_t m_position;
+};
+
+static inline i64 unzigzag(u64 value)
+{
+    return (i64) (value >> 1) ^ -(i64) (value & 1);
+}
+
+InterpreterA11::InterpreterA11(Log* log)
+: m_log(log),
+  m_main(0),
+  m_version(0),
+  m_isLoaded(false),
+  m_threading(-1),
+  m_sp(0),
+  m_isProfiling(false),
+  m_isJitting(false),
+  m_jitDepth(0)
+{
+}
+
+void InterpreterA11::registerNative(std::string name, NativeA11 native)
+{
+    std::vector<std::pair<std::string, NativeA11> >& bucket = m_registry[hashNameA11(name)];
+    for(std::vector<std::pair<std::string, NativeA11> >::iterator i = bucket.begin(); i != bucket.end(); i++)
+        if(i->first == name)
+        {
+            i->second = native;
+            return;
+        }
+    bucket.push_back(std::make_pair(name, native));
+}
+
+NativeA11 InterpreterA11::findNative(u32 hash, const std::string& name) const
+{
+    std::unordered_map<u32, std::vector<std::pair<std::string, NativeA11> > >::const_iterator bucket = m_registry.find(hash);
+    if(bucket == m_registry.end()) return 0;
+    for(std::vector<std::pair<std::string, NativeA11> >::const_iterator i = bucket->second.begin(); i != bucket->second.end(); i++)
+        if(i->first == name) return i->second;
+    return 0;
+}
+
+void InterpreterA11::trap(std::string message)
+{
+    m_log->abort("trap: " + message);
+}
+
+void InterpreterA11::load(const u8* data, size_t size)
+{
+    m_isLoaded = false;
+    m_threading = -1;
+
+    Reader in(m_log, data, size);
+    u8 magic[4];
+    in.read(magic, 4);
+    if(magic[0] != 'A' || magic[1] != 'B' || magic[2] != 'Y' || magic[3] != 27)
+        m_log->abort("not an A11 bytecode file");
+
+    in.read(&m_version, 2);
+    if(m_version & ~(ABY_SUPERINSTRUCTIONS | ABY_COMPACT | ABY_FRAMES | ABY_INDEXED))
+        m_log->abort("unsupported bytecode version " + std::to_string(m_version));
+
+    m_superinstructions.assign(256, std::vector<u8>());
+    if(m_version & ABY_SUPERINSTRUCTIONS)
+    {
+        u8 superc = in.readByte();
+        for(u32 i = 0; i < superc; i++)
+        {
+            u8 opcode = in.readByte();
+            u8 length = in.readByte();
+            u8 components[SUPERINSTRUCTION_LENGTH];
+            in.read(components, SUPERINSTRUCTION_LENGTH);
+            if(length < 2 || length > SUPERINSTRUCTION_LENGTH || findInstructionA11(opcode))
+                m_log->abort("invalid superinstruction table");
+            m_superinstructions[opcode].assign(components, components + length);
+        }
+    }
+
+    if(m_version & ABY_INDEXED)
+    {
+        loadIndexed(data, size, in.getPosition());
+        m_isLoaded = true;
+        return;
+    }
+
+    m_natives.resize(in.read4());
+    for(std::vector<Native>::iterator i = m_natives.begin(); i != m_natives.end(); i++)
+    {
+        i->name = in.readString();
+        i->function = findNative(hashNameA11(i->name), i->name);
+    }
+
+    m_functions.resize(in.read4());
+    for(std::vector<Function>::iterator i = m_functions.begin(); i != m_functions.end(); i++)
+    {
+        i->sourceSize = in.read4();
+        i->declaredFrameSize = 0;
+        i->declaredMaxStack = 0;
+        if(m_version & ABY_FRAMES)
+        {
+            i->declaredFrameSize = in.read4();
+            i->declaredMaxStack = in.read4();
+        }
+        i->source = data + in.getPosition();
+        i->isDecoded = false;
+        in.skip(i->sourceSize);
+    }
+
+    m_main = in.read4();
+    m_globals.assign(in.read4(), 0);
+    if(m_main >= m_functions.size()) m_log->abort("main function " + std::to_string(m_main) + " not found");
+
+    for(std::vector<Function>::iterator i = m_functions.begin(); i != m_functions.end(); i++)
+    {
+        prepare(&*i);
+        i->source = 0;
+    }
+    m_isLoaded = true;
+}
+
+void InterpreterA11::loadIndexed(const u8* data, size_t size, size_t position)
+{
+    Reader in(m_log, data, size);
+    in.skip(position);
+
+    u32 nativec = in.read4();
+    u32 functionc = in.read4();
+    m_main = in.read4();
+    m_globals.assign(in.read4(), 0);
+    u32 poolOffset = in.read4();
+    u32 poolSize = in.read4();
+    if(poolOffset > size || size - poolOffset < poolSize)
+        m_log->abort("invalid string pool");
+    const char* pool = (const char*) data + poolOffset;
+
+    m_natives.resize(nativec);
+    for(std::vector<Native>::iterator i = m_natives.begin(); i != m_natives.end(); i++)
+    {
+        u32 nameOffset = in.read4();
+        u32 nameSize = in.read4();
+        u32 hash = in.read4();
+        if(nameOffset > poolSize || poolSize - nameOffset < nameSize)
+            m_log->abort("invalid native name");
+        i->name.assign(pool + nameOffset, nameSize);
+        i->function = findNative(hash, i->name);
+    }
+
+    m_functions.resize(functionc);
+    for(u32 i = 0; i < functionc; i++)
+    {
+        Function& function = m_functions[i];
+        u32 offset = in.read4();
+        function.sourceSize = in.read4();
+        function.declaredFrameSize = 0;
+        function.declaredMaxStack = 0;
+        if(m_version & ABY_FRAMES)
+        {
+            function.declaredFrameSize = in.read4();
+            function.declaredMaxStack = in.read4();
+        }
+        if(offset > size || size - offset < function.sourceSize)
+            m_log->abort("function " + std::to_string(i) + " out of range");
+        function.source = data + offset;
+        function.isDecoded = false;
+        function.isThreaded = false;
+        function.isCompiled = false;
+        function.native = 0;
+    }
+
+    if(m_main >= m_functions.size()) m_log->abort("main function " + std::to_string(m_main) + " not found");
+}
+
+void InterpreterA11::prepare(Function* function)
+{
+    u32 id = function - m_functions.data();
+    decodeFunction(id, function->source, function->sourceSize, m_version & ABY_COMPACT, m_superinstructions);
+    if(m_version & ABY_FRAMES) applyFrame(id, function->declaredFrameSize, function->declaredMaxStack);
+    if(m_threading >= 0) threadFunction(function);
+}
+
+static void getStackUse(u8 opcode, u32* pops, u32* pushes)
+{
+    ShapeA11 shape;
+    if(getShapeA11(opcode, &shape))
+    {
+        *pops = shape.operandc * shape.operandWidth;
+        *pushes = shape.resultWidth;
+        return;
+    }
+
+    *pops = 0;
+    *pushes = 0;
+    switch(opcode)
+    {
+    case OP_ICMP4: case OP_FICMP4: case OP_FICMPR4: case OP_FUCMP4: case OP_FUCMPR4: *pops = 8; *pushes = 4; break;
+    case OP_ICMP8: case OP_FICMP8: case OP_FICMPR8: case OP_FUCMP8: case OP_FUCMPR8: *pops = 16; *pushes = 4; break;
+    case OP_PUSH4: case OP_FETCH4: case OP_FETCHWIDE4: *pushes = 4; break;
+    case OP_PUSH8: case OP_FETCH8: case OP_FETCHWIDE8: case OP_VARPTR: case OP_VARPTRWIDE: *pushes = 8; break;
+    case OP_POP4: case OP_LOAD4: case OP_LOADWIDE4: case OP_IF: case OP_IFN: *pops = 4; break;
+    case OP_POP8: case OP_LOAD8: case OP_LOADWIDE8: case OP_FREE: *pops = 8; break;
+    case OP_ALLOC: case OP_REFL8: *pops = 8; *pushes = 8; break;
+    case OP_REFL1: case OP_REFL2: case OP_REFL4: *pops = 8; *pushes = 4; break;
+    case OP_EXTR1: case OP_EXTR2: case OP_EXTR4: *pops = 12; break;
+    case OP_EXTR8: *pops = 16; break;
+    case OP_SWAP4: *pops = 8; *pushes = 8; break;
+    case OP_SWAP8: *pops = 16; *pushes = 16; break;
+    case OP_SWAP48: case OP_SWAP84: *pops = 12; *pushes = 12; break;
+    case OP_DUP4: *pops = 4; *pushes = 8; break;
+    case OP_DUP8: *pops = 8; *pushes = 16; break;
+    default: break;
+    }
+}
+
+void InterpreterA11::decodeFunction(u32 id, const u8* code, u32 size, bool isCompact, const std::vector<std::vector<u8> >& superinstructions)
+{
+    Function& function = m_functions[id];
+    function.code.clear();
+    function.opcodes.clear();
+    function.frameSize = 0;
+    function.isVerified = false;
+    function.isCompiled = false;
+    function.native = 0;
+    function.isDecoded = true;
+    function.isThreaded = false;
+
+    std::string where = " in function " + std::to_string(id);
+    std::vector<u32> cells(size + 1, 0xFFFFFFFF);
+    std::vector<std::pair<u32, size_t> > branches;
+
+    Reader in(m_log, code, size);
+    while(!in.isEnd())
+    {
+        cells[in.getPosition()] = function.code.size();
+        u8 opcode = in.readByte();
+        const std::vector<u8>& fused = superinstructions[opcode];
+        const u8* components = fused.empty() ? &opcode : fused.data();
+        size_t componentc = fused.empty() ? 1 : fused.size();
+
+        for(const u8* c = components; c != components + componentc; c++)
+        {
+            const InstructionA11* instruction = findInstructionA11(*c);
+            if(!instruction)
+            {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "0x%02X", *c);
+                m_log->abort("invalid opcode " + std::string(hex) + where);
+            }
+
+            Cell cell;
+            cell.handler = 0;
+            cell.operand = 0;
+            size_t operandBegin = in.getPosition();
+            switch(instruction->operand)
+            {
+            case OPERAND_NONE: break;
+            case OPERAND_INT4:
+            case OPERAND_FLOAT4: cell.operand = isCompact ? (u32) unzigzag(in.readVarint()) : in.read4(); break;
+            case OPERAND_INT8:
+            case OPERAND_FLOAT8: cell.operand = isCompact ? (u64) unzigzag(in.readVarint()) : in.read8(); break;
+            case OPERAND_LABEL:
+                cell.operand = isCompact ? (u64) ((i64) operandBegin + unzigzag(in.readVarint())) : in.read4();
+                branches.push_back(std::make_pair((u32) function.code.size(), operandBegin));
+                break;
+            default: cell.operand = isCompact ? in.readVarint() : in.read4(); break;
+            }
+
+            switch(instruction->operand)
+            {
+            case OPERAND_LVAR:
+            case OPERAND_LVAR_DEF:
+                function.frameSize = std::max<u64>(function.frameSize, cell.operand + std::max<u8>(instruction->varSize, 8));
+                break;
+            case OPERAND_GVAR:
+            case OPERAND_GVAR_DEF:
+                if(cell.operand + instruction->varSize > m_globals.size())
+                    m_log->abort("globalvar offset " + std::to_string(cell.operand) + " out of range" + where);
+                break;
+            case OPERAND_FUNCTION:
+                if(cell.operand >= m_functions.size())
+                    m_log->abort("function " + std::to_string(cell.operand) + " not found" + where);
+                break;
+            case OPERAND_NATIVE:
+                if(cell.operand >= m_natives.size())
+                    m_log->abort("native " + std::to_string(cell.operand) + " not found" + where);
+                break;
+            default: break;
+            }
+
+            function.code.push_back(cell);
+            function.opcodes.push_back(*c);
+        }
+    }
+
+    for(std::vector<std::pair<u32, size_t> >::iterator i = branches.begin(); i != branches.end(); i++)
+    {
+        Cell& cell = function.code[i->first];
+        if(cell.operand >= size || cells[cell.operand] == 0xFFFFFFFF)
+            m_log->abort("invalid branch target " + std::to_string(cell.operand) + where);
+        cell.operand = cells[cell.operand];
+    }
+
+    Cell end;
+    end.handler = 0;
+    end.operand = 0;
+    function.code.push_back(end);
+    function.opcodes.push_back(OP_RETURN);
+
+    function.floors.assign(function.code.size(), 0);
+    for(size_t i = function.code.size(); i-- > 0; )
+    {
+        u32 pops, pushes;
+        getStackUse(function.opcodes[i], &pops, &pushes);
+        i64 floor = pops;
+        if(!isControlFlowA11(function.opcodes[i])) floor = std::max<i64>(floor, floor - pushes + function.floors[i + 1]);
+        function.floors[i] = floor;
+    }
+
+    u32 run = 0;
+    function.slack = 0;
+    for(std::vector<u8>::iterator i = function.opcodes.begin(); i != function.opcodes.end(); i++)
+    {
+        run = isControlFlowA11(*i) ? 0 : run + 1;
+        function.slack = std::max(function.slack, run);
+    }
+    function.slack = (function.slack + 1) * 8;
+    function.frameSize = (function.frameSize + 7) & ~7u;
+    if(function.frameSize > INTERPRETER_LOCALS_SIZE)
+        m_log->abort("frame too large" + where);
+}
+
+void InterpreterA11::applyFrame(u32 id, u32 frameSize, u32 maxStack)
+{
+    Function& function = m_functions[id];
+    if(frameSize > INTERPRETER_LOCALS_SIZE || maxStack > INTERPRETER_STACK_SIZE)
+        m_log->abort("frame too large in function " + std::to_string(id));
+    function.frameSize = std::max(function.frameSize, (frameSize + 7) & ~7u);
+    function.slack = (maxStack + 7) & ~7u;
+    function.isVerified = true;
+}
+
+void InterpreterA11::thread(const void* const* handlers)
+{
+    std::memcpy(m_handlers, handlers, sizeof(m_handlers));
+    for(std::vector<Function>::iterator f = m_functions.begin(); f != m_functions.end(); f++)
+        if(f->isDecoded) threadFunction(&*f);
+}
+
+void InterpreterA11::threadFunction(Function* function)
+{
+    for(u32 i = 0; i < function->code.size(); i++)
+    {
+        Cell& cell = function->code[i];
+        u8 opcode = function->opcodes[i];
+        cell.handler = m_handlers[opcode];
+        if(function->isVerified && opcode == OP_GOTO) cell.handler = m_handlers[HANDLER_GOTO_UNCHECKED];
+        if(function->isVerified && opcode == OP_IF) cell.handler = m_handlers[HANDLER_IF_UNCHECKED];
+        if(function->isVerified && opcode == OP_IFN) cell.handler = m_handlers[HANDLER_IFN_UNCHECKED];
+        if(function->isThreaded) continue;
+        switch(findInstructionA11(opcode)->operand)
+        {
+        case OPERAND_LABEL: cell.operand = (u64) (uintptr_t) &function->code[cell.operand]; break;
+        case OPERAND_FUNCTION: cell.operand = (u64) (uintptr_t) &m_functions[cell.operand]; break;
+        case OPERAND_NATIVE: cell.operand = (u64) (uintptr_t) &m_natives[cell.operand]; break;
+        default: break;
+        }
+    }
+    function->isThreaded = true;
+}
+
+i32 InterpreterA11::run()
+{
+    if(!m_isLoaded) m_log->abort("no bytecode loaded");
+
+    m_stack.assign(INTERPRETER_STACK_SIZE, 0);
+    m_locals.assign(INTERPRETER_LOCALS_SIZE, 0);
+    m_frames.clear();
+    m_frames.reserve(INTERPRETER_CALL_DEPTH);
+    m_jitDepth = 0;
+    m_jitContext.globals = m_globals.data();
+    m_jitContext.stackBase = m_stack.data();
+    m_jitContext.stackEnd = m_stack.data() + m_stack.size();
+    m_jitContext.interpreter = this;
+    if(!m_functions[m_main].isDecoded) prepare(&m_functions[m_main]);
+
+    u8* sp = m_stack.data();
+    if(m_isProfiling)
+    {
+        m_pairs.assign(0x10000, 0);
+        m_triples.clear();
+        sp = execute<true>(&m_functions[m_main], m_locals.data(), sp);
+    }
+    else if(m_isJitting)
+    {
+        execute<false>(0, 0, sp);
+        sp = invoke(&m_functions[m_main], sp, m_locals.data());
+    }
+    else sp = execute<false>(&m_functions[m_main], m_locals.data(), sp);
+
+    if(sp - m_stack.data() < 4) return 0;
+    i32 status;
+    std::memcpy(&status, sp - 4, 4);
+    return status;
+}
+
+void InterpreterA11::writeProfile(std::ostream& out) const
+{
+    std::vector<std::pair<u64, u32> > sequences;
+    for(u32 i = 0; i < m_pairs.size(); i++)
+        if(m_pairs[i]) sequences.push_back(std::make_pair(m_pairs[i], i));
+    for(std::unordered_map<u32, u64>::const_iterator i = m_triples.begin(); i != m_triples.end(); i++)
+        sequences.push_back(std::make_pair(i->second, i->first | 0x80000000));
+    std::sort(sequences.begin(), sequences.end(), [](const std::pair<u64, u32>& a, const std::pair<u64, u32>& b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    out << "# count opcodes...\n";
+    for(std::vector<std::pair<u64, u32> >::iterator i = sequences.begin(); i != sequences.end(); i++)
+    {
+        bool isTriple = i->second & 0x80000000;
+        char line[32];
+        if(isTriple) std::snprintf(line, sizeof(line), " %02x %02x %02x\n", (i->second >> 16) & 0xFF, (i->second >> 8) & 0xFF, i->second & 0xFF);
+        else std::snprintf(line, sizeof(line), " %02x %02x\n", (i->second >> 8) & 0xFF, i->second & 0xFF);
+        out << i->first << line;
+    }
+}
@@ -0,0 +1,190 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: interpreter.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef INTERPRETER_A11_H_
+#define INTERPRETER_A11_H_
+
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../common.h"
+#include "../log.h"
+#include "instructions.h"
+#include "jit.h"
+
+#define INTERPRETER_STACK_SIZE      (8 << 20)
+#define INTERPRETER_LOCALS_SIZE     (16 << 20)
+#define INTERPRETER_CALL_DEPTH      (1 << 16)
+
+#define HANDLER_GOTO_UNCHECKED      256
+#define HANDLER_IF_UNCHECKED        257
+#define HANDLER_IFN_UNCHECKED       258
+#define HANDLER_COUNT               259
+
+class InterpreterA11;
+
+typedef void (*NativeA11)(InterpreterA11* interpreter);
+
+class InterpreterA11
+{
+public:
+    InterpreterA11(Log* log);
+    ~InterpreterA11() {}
+
+    void registerNative(std::string name, NativeA11 native);
+    // Indexed bytecode is decoded on first call, so data must outlive the interpreter.
+    void load(const u8* data, size_t size);
+
+    void setProfiling(bool profiling) { m_isProfiling = profiling; }
+    void setJit(bool jit);
+    void writeProfile(std::ostream& out) const;
+
+    i32 run();
+
+    inline u32 pop4() { checkNativePop(4); m_sp -= 4; u32 value; std::memcpy(&value, m_sp, 4); return value; }
+    inline u64 pop8() { checkNativePop(8); m_sp -= 8; u64 value; std::memcpy(&value, m_sp, 8); return value; }
+    inline void push4(u32 value) { checkNativePush(4); std::memcpy(m_sp, &value, 4); m_sp += 4; }
+    inline void push8(u64 value) { checkNativePush(8); std::memcpy(m_sp, &value, 8); m_sp += 8; }
+
+    inline u8* getGlobals() { return m_globals.data(); }
+    inline Log* getLog() { return m_log; }
+    void trap(std::string message);
+private:
+    struct Cell
+    {
+        const void* handler;
+        u64 operand;
+    };
+
+    struct JitContext
+    {
+        u8* globals;
+        u8* stackBase;
+        u8* stackEnd;
+        InterpreterA11* interpreter;
+    };
+
+    typedef u8* (*JitCode)(u8* sp, u8* locals, JitContext* context);
+
+    struct Function
+    {
+        std::vector<Cell> code;
+        std::vector<u8> opcodes;
+        // How far below sp the straight-line run starting at each cell reaches.
+        std::vector<u32> floors;
+        u32 frameSize;
+        u32 slack;
+        bool isVerified;
+        bool isCompiled;
+        JitCode native;
+
+        const u8* source;
+        u32 sourceSize;
+        u32 declaredFrameSize;
+        u32 declaredMaxStack;
+        bool isDecoded;
+        bool isThreaded;
+    };
+
+    struct Native
+    {
+        std::string name;
+        NativeA11 function;
+    };
+
+    struct Frame
+    {
+        const Cell* ip;
+        u8* locals;
+        Function* function;
+    };
+
+    Log* m_log;
+    std::unordered_map<u32, std::vector<std::pair<std::string, NativeA11> > > m_registry;
+
+    std::vector<Function> m_functions;
+    std::vector<Native> m_natives;
+    std::vector<u8> m_globals;
+    u32 m_main;
+    u16 m_version;
+    std::vector<std::vector<u8> > m_superinstructions;
+    bool m_isLoaded;
+    int m_threading;
+    const void* m_handlers[HANDLER_COUNT];
+
+    std::vector<u8> m_stack;
+    std::vector<u8> m_locals;
+    std::vector<Frame> m_frames;
+    u8* m_sp;
+
+    bool m_isProfiling;
+    std::vector<u64> m_pairs;
+    std::unordered_map<u32, u64> m_triples;
+
+    bool m_isJitting;
+    u32 m_jitDepth;
+    JitContext m_jitContext;
+    ExecutableMemory m_executable;
+
+    NativeA11 findNative(u32 hash, const std::string& name) const;
+    void loadIndexed(const u8* data, size_t size, size_t position);
+
+    void prepare(Function* function);
+    void decodeFunction(u32 id, const u8* code, u32 size, bool isCompact, const std::vector<std::vector<u8> >& superinstructions);
+    void applyFrame(u32 id, u32 frameSize, u32 maxStack);
+    void thread(const void* const* handlers);
+    void threadFunction(Function* function);
+
+    inline void checkNativePush(u32 size)
+    {
+        if(m_sp + size > m_stack.data() + m_stack.size()) trap("operand stack overflow in native");
+    }
+
+    inline void checkNativePop(u32 size)
+    {
+        if(m_sp < m_stack.data() + size) trap("operand stack underflow in native");
+    }
+
+    inline void count(u32 history, u32 length)
+    {
+        if(length >= 2) m_pairs[history & 0xFFFF]++;
+        if(length >= 3) m_triples[history & 0xFFFFFF]++;
+    }
+
+    template<bool PROFILE>
+    u8* execute(Function* function, u8* locals, u8* sp);
+
+    u8* invoke(Function* function, u8* sp, u8* locals);
+    void compile(Function* function);
+
+    static u8* jitCall(JitContext* context, u8* sp, u8* locals, Function* function);
+    static u8* jitNative(JitContext* context, u8* sp, const Native* native);
+    static u8* jitStep(JitContext* context, u8* sp, u32 opcode);
+    static void jitOverflow(JitContext* context);
+    static void jitUnderflow(JitContext* context);
+};
+
+#endif /* INTERPRETER_A11_H_ */
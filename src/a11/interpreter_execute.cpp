@@ -0,0 +1,407 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: interpreter_execute.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "interpreter.h"
+
+#include <cstdlib>
+#include <limits>
+
+#include "semantics.h"
+
+#define POP(T, name)        T name; sp -= sizeof(T); std::memcpy(&name, sp, sizeof(T))
+#define PUSH(T, value)      do { T pushed = (value); std::memcpy(sp, &pushed, sizeof(T)); sp += sizeof(T); } while(0)
+#define PEEK(T, name)       T name; std::memcpy(&name, sp - sizeof(T), sizeof(T))
+
+#define DISPATCH()          do { if(PROFILE) PROFILE_OPCODE(); goto *ip->handler; } while(0)
+#define NEXT()              do { ip++; DISPATCH(); } while(0)
+#define CHECK_STACK()                                                       \
+    do                                                                      \
+    {                                                                       \
+        if(sp + function->slack > stackEnd) trap("operand stack overflow"); \
+        if(sp < stackBase + function->floors[ip - function->code.data()])   \
+            trap("operand stack underflow");                                \
+    } while(0)
+
+#define PROFILE_OPCODE()                                                    \
+    do                                                                      \
+    {                                                                       \
+        u8 opcode = function->opcodes[ip - function->code.data()];          \
+        history = (history << 8) | opcode;                                  \
+        count(history, ++historyLength);                                    \
+        if(isControlFlowA11(opcode)) historyLength = 0;                     \
+    } while(0)
+
+#define UNARY(T, R, expression)         { POP(T, a); PUSH(R, expression); NEXT(); }
+#define BINARY(T, R, expression)        { POP(T, b); POP(T, a); PUSH(R, expression); NEXT(); }
+#define DIVIDE(T, expression)                                               \
+    {                                                                       \
+        POP(T, b); POP(T, a);                                               \
+        if(b == 0) trap("division by zero");                                \
+        if(b == (T) -1 && a == std::numeric_limits<T>::min() && std::numeric_limits<T>::is_signed) \
+            trap("integer overflow");                                       \
+        PUSH(T, expression); NEXT();                                        \
+    }
+#define LOCAL(offset)       (locals + (offset))
+#define GLOBAL(offset)      (globals + (offset))
+#define POINTER(value)      ((void*) (uintptr_t) (value))
+
+template<bool PROFILE>
+u8* InterpreterA11::execute(Function* function, u8* locals, u8* sp)
+{
+    const void* handlers[HANDLER_COUNT];
+    for(u32 i = 0; i < HANDLER_COUNT; i++)
+        handlers[i] = &&invalid;
+    handlers[OP_NOP] = &&op_nop;
+    handlers[OP_PUSH4] = &&op_push4;
+    handlers[OP_PUSH8] = &&op_push8;
+    handlers[OP_POP4] = &&op_pop4;
+    handlers[OP_POP8] = &&op_pop8;
+    handlers[OP_LOAD4] = &&op_load4;
+    handlers[OP_LOAD8] = &&op_load8;
+    handlers[OP_LOADWIDE4] = &&op_loadwide4;
+    handlers[OP_LOADWIDE8] = &&op_loadwide8;
+    handlers[OP_FETCH4] = &&op_fetch4;
+    handlers[OP_FETCH8] = &&op_fetch8;
+    handlers[OP_FETCHWIDE4] = &&op_fetchwide4;
+    handlers[OP_FETCHWIDE8] = &&op_fetchwide8;
+    handlers[OP_VARPTR] = &&op_varptr;
+    handlers[OP_VARPTRWIDE] = &&op_varptrwide;
+    handlers[OP_ALLOC] = &&op_alloc;
+    handlers[OP_FREE] = &&op_free;
+    handlers[OP_REFL1] = &&op_refl1;
+    handlers[OP_REFL2] = &&op_refl2;
+    handlers[OP_REFL4] = &&op_refl4;
+    handlers[OP_REFL8] = &&op_refl8;
+    handlers[OP_EXTR1] = &&op_extr1;
+    handlers[OP_EXTR2] = &&op_extr2;
+    handlers[OP_EXTR4] = &&op_extr4;
+    handlers[OP_EXTR8] = &&op_extr8;
+    handlers[OP_SWAP4] = &&op_swap4;
+    handlers[OP_SWAP8] = &&op_swap8;
+    handlers[OP_SWAP48] = &&op_swap48;
+    handlers[OP_SWAP84] = &&op_swap84;
+    handlers[OP_DUP4] = &&op_dup4;
+    handlers[OP_DUP8] = &&op_dup8;
+    handlers[OP_ADDI4] = &&op_addi4;
+    handlers[OP_ADDI8] = &&op_addi8;
+    handlers[OP_ADDF4] = &&op_addf4;
+    handlers[OP_ADDF8] = &&op_addf8;
+    handlers[OP_SUBI4] = &&op_subi4;
+    handlers[OP_SUBI8] = &&op_subi8;
+    handlers[OP_SUBF4] = &&op_subf4;
+    handlers[OP_SUBF8] = &&op_subf8;
+    handlers[OP_MULI4] = &&op_muli4;
+    handlers[OP_MULI8] = &&op_muli8;
+    handlers[OP_MULF4] = &&op_mulf4;
+    handlers[OP_MULF8] = &&op_mulf8;
+    handlers[OP_DIVI4] = &&op_divi4;
+    handlers[OP_DIVI8] = &&op_divi8;
+    handlers[OP_DIVU4] = &&op_divu4;
+    handlers[OP_DIVU8] = &&op_divu8;
+    handlers[OP_DIVF4] = &&op_divf4;
+    handlers[OP_DIVF8] = &&op_divf8;
+    handlers[OP_REMI4] = &&op_remi4;
+    handlers[OP_REMI8] = &&op_remi8;
+    handlers[OP_REMU4] = &&op_remu4;
+    handlers[OP_REMU8] = &&op_remu8;
+    handlers[OP_NEGI4] = &&op_negi4;
+    handlers[OP_NEGI8] = &&op_negi8;
+    handlers[OP_NEGF4] = &&op_negf4;
+    handlers[OP_NEGF8] = &&op_negf8;
+    handlers[OP_SHL4] = &&op_shl4;
+    handlers[OP_SHL8] = &&op_shl8;
+    handlers[OP_SHR4] = &&op_shr4;
+    handlers[OP_SHR8] = &&op_shr8;
+    handlers[OP_SHRU4] = &&op_shru4;
+    handlers[OP_SHRU8] = &&op_shru8;
+    handlers[OP_BNOT4] = &&op_bnot4;
+    handlers[OP_BNOT8] = &&op_bnot8;
+    handlers[OP_BAND4] = &&op_band4;
+    handlers[OP_BAND8] = &&op_band8;
+    handlers[OP_BXOR4] = &&op_bxor4;
+    handlers[OP_BXOR8] = &&op_bxor8;
+    handlers[OP_BOR4] = &&op_bor4;
+    handlers[OP_BOR8] = &&op_bor8;
+    handlers[OP_LNOT4] = &&op_lnot4;
+    handlers[OP_LNOT8] = &&op_lnot8;
+    handlers[OP_LAND4] = &&op_land4;
+    handlers[OP_LAND8] = &&op_land8;
+    handlers[OP_LOR4] = &&op_lor4;
+    handlers[OP_LOR8] = &&op_lor8;
+    handlers[OP_CI14] = &&op_ci14;
+    handlers[OP_CI24] = &&op_ci24;
+    handlers[OP_CI41] = &&op_ci41;
+    handlers[OP_CI42] = &&op_ci42;
+    handlers[OP_CI48] = &&op_ci48;
+    handlers[OP_CI84] = &&op_ci84;
+    handlers[OP_CF48] = &&op_cf48;
+    handlers[OP_CF84] = &&op_cf84;
+    handlers[OP_CFI4] = &&op_cfi4;
+    handlers[OP_CFI8] = &&op_cfi8;
+    handlers[OP_CIF4] = &&op_cif4;
+    handlers[OP_CIF8] = &&op_cif8;
+    handlers[OP_GOTO] = &&op_goto;
+    handlers[OP_CALL] = &&op_call;
+    handlers[OP_RETURN] = &&op_return;
+    handlers[OP_NATIVE] = &&op_native;
+    handlers[OP_IF] = &&op_if;
+    handlers[OP_IFN] = &&op_ifn;
+    handlers[HANDLER_GOTO_UNCHECKED] = &&op_goto_unchecked;
+    handlers[HANDLER_IF_UNCHECKED] = &&op_if_unchecked;
+    handlers[HANDLER_IFN_UNCHECKED] = &&op_ifn_unchecked;
+    handlers[OP_LTNL] = &&op_ltnl;
+    handlers[OP_LENL] = &&op_lenl;
+    handlers[OP_GTNL] = &&op_gtnl;
+    handlers[OP_GENL] = &&op_genl;
+    handlers[OP_EQNL] = &&op_eqnl;
+    handlers[OP_NENL] = &&op_nenl;
+    handlers[OP_CMP4] = &&op_cmp4;
+    handlers[OP_CMP8] = &&op_cmp8;
+    handlers[OP_ICMP4] = &&op_icmp4;
+    handlers[OP_ICMP8] = &&op_icmp8;
+    handlers[OP_IUCMP4] = &&op_iucmp4;
+    handlers[OP_IUCMP8] = &&op_iucmp8;
+    handlers[OP_IUCMPR4] = &&op_iucmpr4;
+    handlers[OP_IUCMPR8] = &&op_iucmpr8;
+    handlers[OP_FCMP4] = &&op_fcmp4;
+    handlers[OP_FCMP8] = &&op_fcmp8;
+    handlers[OP_FICMP4] = &&op_ficmp4;
+    handlers[OP_FICMP8] = &&op_ficmp8;
+    handlers[OP_FICMPR4] = &&op_ficmpr4;
+    handlers[OP_FICMPR8] = &&op_ficmpr8;
+    handlers[OP_FUCMP4] = &&op_fucmp4;
+    handlers[OP_FUCMP8] = &&op_fucmp8;
+    handlers[OP_FUCMPR4] = &&op_fucmpr4;
+    handlers[OP_FUCMPR8] = &&op_fucmpr8;
+    if(m_threading != PROFILE)
+    {
+        thread(handlers);
+        m_threading = PROFILE;
+    }
+    if(!function) return sp;
+
+    u8* const stackBase = m_stack.data();
+    u8* const stackEnd = m_stack.data() + m_stack.size();
+    u8* const localsEnd = m_locals.data() + m_locals.size();
+    u8* const globals = m_globals.data();
+    u32 history = 0;
+    u32 historyLength = 0;
+    size_t base = m_frames.size();
+
+    const Cell* ip = function->code.data();
+    CHECK_STACK();
+    DISPATCH();
+
+op_nop: NEXT();
+op_push4: PUSH(u32, (u32) ip->operand); NEXT();
+op_push8: PUSH(u64, ip->operand); NEXT();
+op_pop4: sp -= 4; NEXT();
+op_pop8: sp -= 8; NEXT();
+
+op_load4: { POP(u32, a); std::memcpy(LOCAL(ip->operand), &a, 4); NEXT(); }
+op_load8: { POP(u64, a); std::memcpy(LOCAL(ip->operand), &a, 8); NEXT(); }
+op_loadwide4: { POP(u32, a); std::memcpy(GLOBAL(ip->operand), &a, 4); NEXT(); }
+op_loadwide8: { POP(u64, a); std::memcpy(GLOBAL(ip->operand), &a, 8); NEXT(); }
+op_fetch4: std::memcpy(sp, LOCAL(ip->operand), 4); sp += 4; NEXT();
+op_fetch8: std::memcpy(sp, LOCAL(ip->operand), 8); sp += 8; NEXT();
+op_fetchwide4: std::memcpy(sp, GLOBAL(ip->operand), 4); sp += 4; NEXT();
+op_fetchwide8: std::memcpy(sp, GLOBAL(ip->operand), 8); sp += 8; NEXT();
+op_varptr: PUSH(u64, (uintptr_t) LOCAL(ip->operand)); NEXT();
+op_varptrwide: PUSH(u64, (uintptr_t) GLOBAL(ip->operand)); NEXT();
+
+op_alloc:
+{
+    POP(u64, size);
+    void* pointer = std::malloc(size ? size : 1);
+    if(!pointer) trap("out of memory");
+    PUSH(u64, (uintptr_t) pointer);
+    NEXT();
+}
+op_free: { POP(u64, pointer); std::free(POINTER(pointer)); NEXT(); }
+
+op_refl1: { POP(u64, pointer); u8 value; std::memcpy(&value, POINTER(pointer), 1); PUSH(u32, value); NEXT(); }
+op_refl2: { POP(u64, pointer); u16 value; std::memcpy(&value, POINTER(pointer), 2); PUSH(u32, value); NEXT(); }
+op_refl4: { POP(u64, pointer); u32 value; std::memcpy(&value, POINTER(pointer), 4); PUSH(u32, value); NEXT(); }
+op_refl8: { POP(u64, pointer); u64 value; std::memcpy(&value, POINTER(pointer), 8); PUSH(u64, value); NEXT(); }
+op_extr1: { POP(u32, value); POP(u64, pointer); u8 narrow = value; std::memcpy(POINTER(pointer), &narrow, 1); NEXT(); }
+op_extr2: { POP(u32, value); POP(u64, pointer); u16 narrow = value; std::memcpy(POINTER(pointer), &narrow, 2); NEXT(); }
+op_extr4: { POP(u32, value); POP(u64, pointer); std::memcpy(POINTER(pointer), &value, 4); NEXT(); }
+op_extr8: { POP(u64, value); POP(u64, pointer); std::memcpy(POINTER(pointer), &value, 8); NEXT(); }
+
+op_swap4: { POP(u32, b); POP(u32, a); PUSH(u32, b); PUSH(u32, a); NEXT(); }
+op_swap8: { POP(u64, b); POP(u64, a); PUSH(u64, b); PUSH(u64, a); NEXT(); }
+op_swap48: { POP(u64, b); POP(u32, a); PUSH(u64, b); PUSH(u32, a); NEXT(); }
+op_swap84: { POP(u32, b); POP(u64, a); PUSH(u32, b); PUSH(u64, a); NEXT(); }
+op_dup4: { PEEK(u32, a); PUSH(u32, a); NEXT(); }
+op_dup8: { PEEK(u64, a); PUSH(u64, a); NEXT(); }
+
+op_addi4: BINARY(u32, u32, a + b)
+op_addi8: BINARY(u64, u64, a + b)
+op_addf4: BINARY(f32, f32, a + b)
+op_addf8: BINARY(f64, f64, a + b)
+op_subi4: BINARY(u32, u32, a - b)
+op_subi8: BINARY(u64, u64, a - b)
+op_subf4: BINARY(f32, f32, a - b)
+op_subf8: BINARY(f64, f64, a - b)
+op_muli4: BINARY(u32, u32, a * b)
+op_muli8: BINARY(u64, u64, a * b)
+op_mulf4: BINARY(f32, f32, a * b)
+op_mulf8: BINARY(f64, f64, a * b)
+op_divi4: DIVIDE(i32, a / b)
+op_divi8: DIVIDE(i64, a / b)
+op_divu4: DIVIDE(u32, a / b)
+op_divu8: DIVIDE(u64, a / b)
+op_divf4: BINARY(f32, f32, a / b)
+op_divf8: BINARY(f64, f64, a / b)
+op_remi4: DIVIDE(i32, a % b)
+op_remi8: DIVIDE(i64, a % b)
+op_remu4: DIVIDE(u32, a % b)
+op_remu8: DIVIDE(u64, a % b)
+op_negi4: UNARY(u32, u32, 0u - a)
+op_negi8: UNARY(u64, u64, 0ull - a)
+op_negf4: UNARY(f32, f32, -a)
+op_negf8: UNARY(f64, f64, -a)
+
+op_shl4: BINARY(u32, u32, a << (b & 31))
+op_shl8: BINARY(u64, u64, a << (b & 63))
+op_shr4: BINARY(u32, u32, (u32) ((i32) a >> (b & 31)))
+op_shr8: BINARY(u64, u64, (u64) ((i64) a >> (b & 63)))
+op_shru4: BINARY(u32, u32, a >> (b & 31))
+op_shru8: BINARY(u64, u64, a >> (b & 63))
+op_bnot4: UNARY(u32, u32, ~a)
+op_bnot8: UNARY(u64, u64, ~a)
+op_band4: BINARY(u32, u32, a & b)
+op_band8: BINARY(u64, u64, a & b)
+op_bxor4: BINARY(u32, u32, a ^ b)
+op_bxor8: BINARY(u64, u64, a ^ b)
+op_bor4: BINARY(u32, u32, a | b)
+op_bor8: BINARY(u64, u64, a | b)
+
+op_lnot4: UNARY(u32, u32, a == 0)
+op_lnot8: UNARY(u64, u64, a == 0)
+op_land4: BINARY(u32, u32, a != 0 && b != 0)
+op_land8: BINARY(u64, u64, a != 0 && b != 0)
+op_lor4: BINARY(u32, u32, a != 0 || b != 0)
+op_lor8: BINARY(u64, u64, a != 0 || b != 0)
+
+op_ci14: UNARY(u32, u32, (u32) (i32) (i8) a)
+op_ci24: UNARY(u32, u32, (u32) (i32) (i16) a)
+op_ci41: UNARY(u32, u32, (u8) a)
+op_ci42: UNARY(u32, u32, (u16) a)
+op_ci48: UNARY(i32, u64, (u64) (i64) a)
+op_ci84: UNARY(u64, u32, (u32) a)
+op_cf48: UNARY(f32, f64, (f64) a)
+op_cf84: UNARY(f64, f32, (f32) a)
+op_cfi4: UNARY(f32, u32, (u32) (truncateA11<f32, i32>(a)))
+op_cfi8: UNARY(f64, u64, (u64) (truncateA11<f64, i64>(a)))
+op_cif4: UNARY(i32, f32, (f32) a)
+op_cif8: UNARY(i64, f64, (f64) a)
+
+op_goto: ip = (const Cell*) ip->operand; CHECK_STACK(); DISPATCH();
+op_if: { POP(u32, a); ip = a ? (const Cell*) ip->operand : ip + 1; CHECK_STACK(); DISPATCH(); }
+op_ifn: { POP(u32, a); ip = a ? ip + 1 : (const Cell*) ip->operand; CHECK_STACK(); DISPATCH(); }
+op_goto_unchecked: ip = (const Cell*) ip->operand; DISPATCH();
+op_if_unchecked: { POP(u32, a); ip = a ? (const Cell*) ip->operand : ip + 1; DISPATCH(); }
+op_ifn_unchecked: { POP(u32, a); ip = a ? ip + 1 : (const Cell*) ip->operand; DISPATCH(); }
+
+op_ltnl: UNARY(i32, u32, a < 0)
+op_lenl: UNARY(i32, u32, a <= 0)
+op_gtnl: UNARY(i32, u32, a > 0)
+op_genl: UNARY(i32, u32, a >= 0)
+op_eqnl: UNARY(i32, u32, a == 0)
+op_nenl: UNARY(i32, u32, a != 0)
+
+op_cmp4: BINARY(i32, u32, (u32) compareA11(a, b))
+op_cmp8: { POP(i64, b); POP(i64, a); PUSH(u32, (u32) compareA11(a, b)); NEXT(); }
+op_icmp4: BINARY(i32, u32, (u32) compareA11(b, a))
+op_icmp8: { POP(i64, b); POP(i64, a); PUSH(u32, (u32) compareA11(b, a)); NEXT(); }
+op_iucmp4: BINARY(u32, u32, (u32) compareA11(a, b))
+op_iucmp8: { POP(u64, b); POP(u64, a); PUSH(u32, (u32) compareA11(a, b)); NEXT(); }
+op_iucmpr4: BINARY(u32, u32, (u32) compareA11(b, a))
+op_iucmpr8: { POP(u64, b); POP(u64, a); PUSH(u32, (u32) compareA11(b, a)); NEXT(); }
+op_fcmp4: { POP(f32, b); POP(f32, a); PUSH(u32, (u32) compareA11(a, b)); NEXT(); }
+op_fcmp8: { POP(f64, b); POP(f64, a); PUSH(u32, (u32) compareA11(a, b)); NEXT(); }
+op_ficmp4: { POP(f32, b); POP(f32, a); PUSH(u32, compareNaNA11(a, b, -1)); NEXT(); }
+op_ficmp8: { POP(f64, b); POP(f64, a); PUSH(u32, compareNaNA11(a, b, -1)); NEXT(); }
+op_ficmpr4: { POP(f32, b); POP(f32, a); PUSH(u32, compareNaNA11(b, a, -1)); NEXT(); }
+op_ficmpr8: { POP(f64, b); POP(f64, a); PUSH(u32, compareNaNA11(b, a, -1)); NEXT(); }
+op_fucmp4: { POP(f32, b); POP(f32, a); PUSH(u32, compareNaNA11(a, b, 1)); NEXT(); }
+op_fucmp8: { POP(f64, b); POP(f64, a); PUSH(u32, compareNaNA11(a, b, 1)); NEXT(); }
+op_fucmpr4: { POP(f32, b); POP(f32, a); PUSH(u32, compareNaNA11(b, a, 1)); NEXT(); }
+op_fucmpr8: { POP(f64, b); POP(f64, a); PUSH(u32, compareNaNA11(b, a, 1)); NEXT(); }
+
+op_call:
+{
+    if(m_isJitting)
+    {
+        sp = invoke((Function*) ip->operand, sp, locals + function->frameSize);
+        ip++;
+        CHECK_STACK();
+        DISPATCH();
+    }
+    if(m_frames.size() == INTERPRETER_CALL_DEPTH) trap("call stack overflow");
+    Frame frame;
+    frame.ip = ip + 1;
+    frame.locals = locals;
+    frame.function = function;
+    m_frames.push_back(frame);
+
+    locals += function->frameSize;
+    function = (Function*) ip->operand;
+    if(!function->isDecoded) prepare(function);
+    if(locals + function->frameSize > localsEnd) trap("locals overflow");
+    std::memset(locals, 0, function->frameSize);
+    ip = function->code.data();
+    CHECK_STACK();
+    DISPATCH();
+}
+op_return:
+{
+    if(m_frames.size() == base) return sp;
+    const Frame& frame = m_frames.back();
+    ip = frame.ip;
+    locals = frame.locals;
+    function = frame.function;
+    m_frames.pop_back();
+    CHECK_STACK();
+    DISPATCH();
+}
+op_native:
+{
+    const Native* native = (const Native*) ip->operand;
+    if(!native->function) trap("native \"" + native->name + "\" is not available");
+    m_sp = sp;
+    native->function(this);
+    sp = m_sp;
+    ip++;
+    CHECK_STACK();
+    DISPATCH();
+}
+
+invalid:
+    trap("invalid opcode");
+    return sp;
+}
+
+template u8* InterpreterA11::execute<false>(Function* function, u8* locals, u8* sp);
+template u8* InterpreterA11::execute<true>(Function* function, u8* locals, u8* sp);
@@ -0,0 +1,532 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: interpreter_jit.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "interpreter.h"
+
+#include <cstddef>
+#include <cstdlib>
+
+#ifdef JIT_X64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "semantics.h"
+
+#define STACK       RBX
+#define LOCALS      R12
+#define GLOBALS     R13
+#define CONTEXT     R14
+#define STACK_END   R15
+
+ExecutableMemory::~ExecutableMemory()
+{
+#ifdef JIT_X64
+    for(std::vector<Chunk>::iterator i = m_chunks.begin(); i != m_chunks.end(); i++)
+        munmap(i->data, i->size);
+#endif
+}
+
+void* ExecutableMemory::store(const u8* code, size_t size)
+{
+#ifdef JIT_X64
+    if(m_chunks.empty() || m_used + size > m_chunks.back().size)
+    {
+        size_t page = sysconf(_SC_PAGESIZE);
+        Chunk chunk;
+        chunk.size = std::max<size_t>(JIT_CHUNK_SIZE, (size + page - 1) / page * page);
+        void* data = mmap(0, chunk.size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(data == MAP_FAILED) return 0;
+        chunk.data = static_cast<u8*>(data);
+        m_chunks.push_back(chunk);
+        m_used = 0;
+    }
+
+    Chunk& chunk = m_chunks.back();
+    if(mprotect(chunk.data, chunk.size, PROT_READ | PROT_WRITE) != 0) return 0;
+    u8* target = chunk.data + m_used;
+    std::memcpy(target, code, size);
+    m_used = (m_used + size + 15) & ~(size_t) 15;
+    if(mprotect(chunk.data, chunk.size, PROT_READ | PROT_EXEC) != 0) std::abort();
+    return target;
+#else
+    return 0;
+#endif
+}
+
+void InterpreterA11::setJit(bool jit)
+{
+#ifdef JIT_X64
+    if(jit && m_log->isAbortThrowing())
+    {
+        m_log->warning("JIT disabled, traps cannot unwind through compiled code");
+        jit = false;
+    }
+    m_isJitting = jit;
+#else
+    if(jit) m_log->warning("JIT is not supported on this platform");
+#endif
+}
+
+u8* InterpreterA11::invoke(Function* function, u8* sp, u8* locals)
+{
+    if(m_jitDepth == JIT_CALL_DEPTH) trap("call stack overflow");
+    if(!function->isDecoded) prepare(function);
+    if(locals + function->frameSize > m_locals.data() + m_locals.size()) trap("locals overflow");
+    if(sp + function->slack > m_jitContext.stackEnd) trap("operand stack overflow");
+    if(sp < m_jitContext.stackBase + function->floors[0]) trap("operand stack underflow");
+    std::memset(locals, 0, function->frameSize);
+    if(!function->isCompiled) compile(function);
+
+    m_jitDepth++;
+    sp = function->native ? function->native(sp, locals, &m_jitContext) : execute<false>(function, locals, sp);
+    m_jitDepth--;
+    return sp;
+}
+
+u8* InterpreterA11::jitCall(JitContext* context, u8* sp, u8* locals, Function* function)
+{
+    return context->interpreter->invoke(function, sp, locals);
+}
+
+u8* InterpreterA11::jitNative(JitContext* context, u8* sp, const Native* native)
+{
+    InterpreterA11* interpreter = context->interpreter;
+    if(!native->function) interpreter->trap("native \"" + native->name + "\" is not available");
+    interpreter->m_sp = sp;
+    native->function(interpreter);
+    return interpreter->m_sp;
+}
+
+void InterpreterA11::jitOverflow(JitContext* context)
+{
+    context->interpreter->trap("operand stack overflow");
+}
+
+void InterpreterA11::jitUnderflow(JitContext* context)
+{
+    context->interpreter->trap("operand stack underflow");
+}
+
+template<typename T>
+static inline T checkDivision(InterpreterA11* interpreter, T a, T b)
+{
+    if(b == 0) interpreter->trap("division by zero");
+    if(std::numeric_limits<T>::is_signed && b == (T) -1 && a == std::numeric_limits<T>::min())
+        interpreter->trap("integer overflow");
+    return b;
+}
+
+u8* InterpreterA11::jitStep(JitContext* context, u8* sp, u32 opcode)
+{
+    InterpreterA11* vm = context->interpreter;
+    vm->m_sp = sp;
+    switch(opcode)
+    {
+    case OP_DIVI4: { i32 b = vm->pop4(), a = vm->pop4(); checkDivision(vm, a, b); vm->push4((u32) (a / b)); break; }
+    case OP_DIVI8: { i64 b = vm->pop8(), a = vm->pop8(); checkDivision(vm, a, b); vm->push8((u64) (a / b)); break; }
+    case OP_DIVU4: { u32 b = vm->pop4(), a = vm->pop4(); checkDivision(vm, a, b); vm->push4(a / b); break; }
+    case OP_DIVU8: { u64 b = vm->pop8(), a = vm->pop8(); checkDivision(vm, a, b); vm->push8(a / b); break; }
+    case OP_REMI4: { i32 b = vm->pop4(), a = vm->pop4(); checkDivision(vm, a, b); vm->push4((u32) (a % b)); break; }
+    case OP_REMI8: { i64 b = vm->pop8(), a = vm->pop8(); checkDivision(vm, a, b); vm->push8((u64) (a % b)); break; }
+    case OP_REMU4: { u32 b = vm->pop4(), a = vm->pop4(); checkDivision(vm, a, b); vm->push4(a % b); break; }
+    case OP_REMU8: { u64 b = vm->pop8(), a = vm->pop8(); checkDivision(vm, a, b); vm->push8(a % b); break; }
+
+    case OP_CF48: vm->push8(toBitsA11((f64) fromBitsA11<f32>(vm->pop4()))); break;
+    case OP_CF84: vm->push4((u32) toBitsA11((f32) fromBitsA11<f64>(vm->pop8()))); break;
+    case OP_CFI4: vm->push4((u32) truncateA11<f32, i32>(fromBitsA11<f32>(vm->pop4()))); break;
+    case OP_CFI8: vm->push8((u64) truncateA11<f64, i64>(fromBitsA11<f64>(vm->pop8()))); break;
+    case OP_CIF4: vm->push4((u32) toBitsA11((f32) (i32) vm->pop4())); break;
+    case OP_CIF8: vm->push8(toBitsA11((f64) (i64) vm->pop8())); break;
+
+    case OP_FCMP4: { f32 b = fromBitsA11<f32>(vm->pop4()), a = fromBitsA11<f32>(vm->pop4()); vm->push4((u32) compareA11(a, b)); break; }
+    case OP_FCMP8: { f64 b = fromBitsA11<f64>(vm->pop8()), a = fromBitsA11<f64>(vm->pop8()); vm->push4((u32) compareA11(a, b)); break; }
+    case OP_FICMP4: { f32 b = fromBitsA11<f32>(vm->pop4()), a = fromBitsA11<f32>(vm->pop4()); vm->push4(compareNaNA11(a, b, -1)); break; }
+    case OP_FICMP8: { f64 b = fromBitsA11<f64>(vm->pop8()), a = fromBitsA11<f64>(vm->pop8()); vm->push4(compareNaNA11(a, b, -1)); break; }
+    case OP_FICMPR4: { f32 b = fromBitsA11<f32>(vm->pop4()), a = fromBitsA11<f32>(vm->pop4()); vm->push4(compareNaNA11(b, a, -1)); break; }
+    case OP_FICMPR8: { f64 b = fromBitsA11<f64>(vm->pop8()), a = fromBitsA11<f64>(vm->pop8()); vm->push4(compareNaNA11(b, a, -1)); break; }
+    case OP_FUCMP4: { f32 b = fromBitsA11<f32>(vm->pop4()), a = fromBitsA11<f32>(vm->pop4()); vm->push4(compareNaNA11(a, b, 1)); break; }
+    case OP_FUCMP8: { f64 b = fromBitsA11<f64>(vm->pop8()), a = fromBitsA11<f64>(vm->pop8()); vm->push4(compareNaNA11(a, b, 1)); break; }
+    case OP_FUCMPR4: { f32 b = fromBitsA11<f32>(vm->pop4()), a = fromBitsA11<f32>(vm->pop4()); vm->push4(compareNaNA11(b, a, 1)); break; }
+    case OP_FUCMPR8: { f64 b = fromBitsA11<f64>(vm->pop8()), a = fromBitsA11<f64>(vm->pop8()); vm->push4(compareNaNA11(b, a, 1)); break; }
+
+    case OP_ALLOC:
+    {
+        u64 size = vm->pop8();
+        void* pointer = std::malloc(size ? size : 1);
+        if(!pointer) vm->trap("out of memory");
+        vm->push8((uintptr_t) pointer);
+        break;
+    }
+    case OP_FREE: std::free((void*) (uintptr_t) vm->pop8()); break;
+
+    case OP_REFL1: { u8 value; std::memcpy(&value, (void*) (uintptr_t) vm->pop8(), 1); vm->push4(value); break; }
+    case OP_REFL2: { u16 value; std::memcpy(&value, (void*) (uintptr_t) vm->pop8(), 2); vm->push4(value); break; }
+    case OP_REFL4: { u32 value; std::memcpy(&value, (void*) (uintptr_t) vm->pop8(), 4); vm->push4(value); break; }
+    case OP_REFL8: { u64 value; std::memcpy(&value, (void*) (uintptr_t) vm->pop8(), 8); vm->push8(value); break; }
+    case OP_EXTR1: { u8 value = vm->pop4(); std::memcpy((void*) (uintptr_t) vm->pop8(), &value, 1); break; }
+    case OP_EXTR2: { u16 value = vm->pop4(); std::memcpy((void*) (uintptr_t) vm->pop8(), &value, 2); break; }
+    case OP_EXTR4: { u32 value = vm->pop4(); std::memcpy((void*) (uintptr_t) vm->pop8(), &value, 4); break; }
+    case OP_EXTR8: { u64 value = vm->pop8(); std::memcpy((void*) (uintptr_t) vm->pop8(), &value, 8); break; }
+
+    case OP_SWAP48: { u64 b = vm->pop8(); u32 a = vm->pop4(); vm->push8(b); vm->push4(a); break; }
+    case OP_SWAP84: { u32 b = vm->pop4(); u64 a = vm->pop8(); vm->push4(b); vm->push8(a); break; }
+    default: vm->trap("invalid opcode");
+    }
+    return vm->m_sp;
+}
+
+#ifdef JIT_X64
+static inline void callHelper(AssemblerX64& x, const void* helper)
+{
+    x.moveImmediate(RAX, (u64) (uintptr_t) helper);
+    x.call(RAX);
+    x.alu(ALU_MOV, true, STACK, RAX);
+}
+
+static inline void emitCompare(AssemblerX64& x, i32 width, bool isSigned, bool isReversed)
+{
+    bool wide = width == 8;
+    x.load(wide, RAX, STACK, -2 * width);
+    x.load(wide, RCX, STACK, -width);
+    if(isReversed) x.alu(ALU_CMP, wide, RCX, RAX);
+    else x.alu(ALU_CMP, wide, RAX, RCX);
+    x.setcc(isSigned ? CC_G : CC_A, RDX);
+    x.setcc(isSigned ? CC_L : CC_B, RCX);
+    x.alu8(ALU_SUB, RDX, RCX);
+    x.movsx8(RAX, RDX);
+    x.store(false, STACK, -2 * width, RAX);
+    x.subImmediate(true, STACK, 2 * width - 4);
+}
+
+static inline void emitBinary(AssemblerX64& x, i32 width, u8 op)
+{
+    bool wide = width == 8;
+    x.load(wide, RAX, STACK, -2 * width);
+    x.load(wide, RCX, STACK, -width);
+    if(op == 0) x.imul(wide, RAX, RCX);
+    else x.alu(op, wide, RAX, RCX);
+    x.store(wide, STACK, -2 * width, RAX);
+    x.subImmediate(true, STACK, width);
+}
+
+static inline void emitShift(AssemblerX64& x, i32 width, u8 extension)
+{
+    bool wide = width == 8;
+    x.load(wide, RAX, STACK, -2 * width);
+    x.load(wide, RCX, STACK, -width);
+    x.shift(extension, wide, RAX);
+    x.store(wide, STACK, -2 * width, RAX);
+    x.subImmediate(true, STACK, width);
+}
+
+static inline void emitLogical(AssemblerX64& x, i32 width, u8 op)
+{
+    bool wide = width == 8;
+    x.load(wide, RAX, STACK, -2 * width);
+    x.load(wide, RCX, STACK, -width);
+    x.alu(ALU_TEST, wide, RAX, RAX);
+    x.setcc(CC_NE, RAX);
+    x.alu(ALU_TEST, wide, RCX, RCX);
+    x.setcc(CC_NE, RCX);
+    x.alu8(op, RAX, RCX);
+    x.movzx8(RAX, RAX);
+    x.store(wide, STACK, -2 * width, RAX);
+    x.subImmediate(true, STACK, width);
+}
+
+static inline void emitTest(AssemblerX64& x, i32 width, u8 condition)
+{
+    bool wide = width == 8;
+    x.load(wide, RAX, STACK, -width);
+    x.alu(ALU_TEST, wide, RAX, RAX);
+    x.setcc(condition, RAX);
+    x.movzx8(RAX, RAX);
+    x.store(wide, STACK, -width, RAX);
+}
+
+static inline void emitFloat(AssemblerX64& x, i32 width, u8 op)
+{
+    u8 prefix = width == 8 ? SSE_DOUBLE : SSE_SINGLE;
+    x.sse(prefix, SSE_LOAD, 0, STACK, -2 * width);
+    x.sse(prefix, op, 0, STACK, -width);
+    x.sse(prefix, SSE_STORE, 0, STACK, -2 * width);
+    x.subImmediate(true, STACK, width);
+}
+#endif
+
+void InterpreterA11::compile(Function* function)
+{
+    function->isCompiled = true;
+#ifdef JIT_X64
+    for(u32 i = 0; i < function->code.size(); i++)
+    {
+        OperandA11 operand = findInstructionA11(function->opcodes[i])->operand;
+        if((operand == OPERAND_GVAR || operand == OPERAND_GVAR_DEF) && function->code[i].operand > 0x7FFFFFF0)
+            return;
+    }
+
+    Emitter code;
+    AssemblerX64 x(&code);
+    x.push(RBX);
+    x.push(R12);
+    x.push(R13);
+    x.push(R14);
+    x.push(R15);
+    x.alu(ALU_MOV, true, STACK, RDI);
+    x.alu(ALU_MOV, true, LOCALS, RSI);
+    x.alu(ALU_MOV, true, CONTEXT, RDX);
+    x.load(true, GLOBALS, CONTEXT, offsetof(JitContext, globals));
+    x.load(true, STACK_END, CONTEXT, offsetof(JitContext, stackEnd));
+
+    std::vector<size_t> offsets(function->code.size());
+    std::vector<std::pair<size_t, u32> > jumps;
+    std::vector<size_t> returns;
+    std::vector<size_t> overflows;
+    std::vector<size_t> underflows;
+    i32 slack = function->slack;
+
+    auto checkFloor = [&](u32 floor)
+    {
+        if(!floor) return;
+        x.load(true, RAX, CONTEXT, offsetof(JitContext, stackBase));
+        x.lea(RAX, RAX, floor);
+        x.alu(ALU_CMP, true, STACK, RAX);
+        underflows.push_back(x.jump(CC_B));
+    };
+
+    for(u32 i = 0; i < function->code.size(); i++)
+    {
+        offsets[i] = x.position();
+        u8 opcode = function->opcodes[i];
+        u64 operand = function->code[i].operand;
+        i32 offset = (i32) operand;
+        u32 target = (const Cell*) (uintptr_t) operand - function->code.data();
+
+        bool isBranch = opcode == OP_GOTO || opcode == OP_IF || opcode == OP_IFN;
+        if(isBranch && !function->isVerified)
+        {
+            x.lea(RAX, STACK, slack);
+            x.alu(ALU_CMP, true, RAX, STACK_END);
+            overflows.push_back(x.jump(CC_A));
+
+            u32 next = opcode == OP_GOTO ? 0 : function->floors[i + 1];
+            checkFloor(function->floors[i] + std::max(function->floors[target], next));
+        }
+
+        switch(opcode)
+        {
+        case OP_NOP: break;
+        case OP_PUSH4: x.storeImmediate(STACK, 0, (u32) operand); x.addImmediate(true, STACK, 4); break;
+        case OP_PUSH8: x.moveImmediate(RAX, operand); x.store(true, STACK, 0, RAX); x.addImmediate(true, STACK, 8); break;
+        case OP_POP4: x.subImmediate(true, STACK, 4); break;
+        case OP_POP8: x.subImmediate(true, STACK, 8); break;
+
+        case OP_LOAD4: case OP_LOAD8: case OP_LOADWIDE4: case OP_LOADWIDE8:
+        {
+            bool wide = opcode == OP_LOAD8 || opcode == OP_LOADWIDE8;
+            u8 base = opcode == OP_LOAD4 || opcode == OP_LOAD8 ? LOCALS : GLOBALS;
+            x.load(wide, RAX, STACK, wide ? -8 : -4);
+            x.store(wide, base, offset, RAX);
+            x.subImmediate(true, STACK, wide ? 8 : 4);
+            break;
+        }
+        case OP_FETCH4: case OP_FETCH8: case OP_FETCHWIDE4: case OP_FETCHWIDE8:
+        {
+            bool wide = opcode == OP_FETCH8 || opcode == OP_FETCHWIDE8;
+            u8 base = opcode == OP_FETCH4 || opcode == OP_FETCH8 ? LOCALS : GLOBALS;
+            x.load(wide, RAX, base, offset);
+            x.store(wide, STACK, 0, RAX);
+            x.addImmediate(true, STACK, wide ? 8 : 4);
+            break;
+        }
+        case OP_VARPTR: case OP_VARPTRWIDE:
+            x.lea(RAX, opcode == OP_VARPTR ? LOCALS : GLOBALS, offset);
+            x.store(true, STACK, 0, RAX);
+            x.addImmediate(true, STACK, 8);
+            break;
+
+        case OP_SWAP4: case OP_SWAP8:
+        {
+            bool wide = opcode == OP_SWAP8;
+            i32 width = wide ? 8 : 4;
+            x.load(wide, RAX, STACK, -width);
+            x.load(wide, RCX, STACK, -2 * width);
+            x.store(wide, STACK, -2 * width, RAX);
+            x.store(wide, STACK, -width, RCX);
+            break;
+        }
+        case OP_DUP4: case OP_DUP8:
+        {
+            bool wide = opcode == OP_DUP8;
+            x.load(wide, RAX, STACK, wide ? -8 : -4);
+            x.store(wide, STACK, 0, RAX);
+            x.addImmediate(true, STACK, wide ? 8 : 4);
+            break;
+        }
+
+        case OP_ADDI4: emitBinary(x, 4, ALU_ADD); break;
+        case OP_ADDI8: emitBinary(x, 8, ALU_ADD); break;
+        case OP_SUBI4: emitBinary(x, 4, ALU_SUB); break;
+        case OP_SUBI8: emitBinary(x, 8, ALU_SUB); break;
+        case OP_MULI4: emitBinary(x, 4, 0); break;
+        case OP_MULI8: emitBinary(x, 8, 0); break;
+        case OP_BAND4: emitBinary(x, 4, ALU_AND); break;
+        case OP_BAND8: emitBinary(x, 8, ALU_AND); break;
+        case OP_BXOR4: emitBinary(x, 4, ALU_XOR); break;
+        case OP_BXOR8: emitBinary(x, 8, ALU_XOR); break;
+        case OP_BOR4: emitBinary(x, 4, ALU_OR); break;
+        case OP_BOR8: emitBinary(x, 8, ALU_OR); break;
+        case OP_SHL4: emitShift(x, 4, 4); break;
+        case OP_SHL8: emitShift(x, 8, 4); break;
+        case OP_SHR4: emitShift(x, 4, 7); break;
+        case OP_SHR8: emitShift(x, 8, 7); break;
+        case OP_SHRU4: emitShift(x, 4, 5); break;
+        case OP_SHRU8: emitShift(x, 8, 5); break;
+
+        case OP_NEGI4: case OP_NEGI8: case OP_BNOT4: case OP_BNOT8:
+        {
+            bool wide = opcode == OP_NEGI8 || opcode == OP_BNOT8;
+            x.load(wide, RAX, STACK, wide ? -8 : -4);
+            x.unary(opcode == OP_NEGI4 || opcode == OP_NEGI8 ? 3 : 2, wide, RAX);
+            x.store(wide, STACK, wide ? -8 : -4, RAX);
+            break;
+        }
+
+        case OP_ADDF4: emitFloat(x, 4, SSE_ADD); break;
+        case OP_ADDF8: emitFloat(x, 8, SSE_ADD); break;
+        case OP_SUBF4: emitFloat(x, 4, SSE_SUB); break;
+        case OP_SUBF8: emitFloat(x, 8, SSE_SUB); break;
+        case OP_MULF4: emitFloat(x, 4, SSE_MUL); break;
+        case OP_MULF8: emitFloat(x, 8, SSE_MUL); break;
+        case OP_DIVF4: emitFloat(x, 4, SSE_DIV); break;
+        case OP_DIVF8: emitFloat(x, 8, SSE_DIV); break;
+        case OP_NEGF4: case OP_NEGF8: x.xorByte(STACK, -1, 0x80); break;
+
+        case OP_LNOT4: emitTest(x, 4, CC_E); break;
+        case OP_LNOT8: emitTest(x, 8, CC_E); break;
+        case OP_LAND4: emitLogical(x, 4, ALU_AND); break;
+        case OP_LAND8: emitLogical(x, 8, ALU_AND); break;
+        case OP_LOR4: emitLogical(x, 4, ALU_OR); break;
+        case OP_LOR8: emitLogical(x, 8, ALU_OR); break;
+        case OP_LTNL: emitTest(x, 4, CC_L); break;
+        case OP_LENL: emitTest(x, 4, CC_LE); break;
+        case OP_GTNL: emitTest(x, 4, CC_G); break;
+        case OP_GENL: emitTest(x, 4, CC_GE); break;
+        case OP_EQNL: emitTest(x, 4, CC_E); break;
+        case OP_NENL: emitTest(x, 4, CC_NE); break;
+
+        case OP_CI14: case OP_CI24: case OP_CI41: case OP_CI42:
+        {
+            u8 op = opcode == OP_CI14 ? 0xBE : opcode == OP_CI24 ? 0xBF : opcode == OP_CI41 ? 0xB6 : 0xB7;
+            x.extend(op, false, RAX, STACK, -4);
+            x.store(false, STACK, -4, RAX);
+            break;
+        }
+        case OP_CI48:
+            x.extend(0x63, true, RAX, STACK, -4);
+            x.store(true, STACK, -4, RAX);
+            x.addImmediate(true, STACK, 4);
+            break;
+        case OP_CI84: x.subImmediate(true, STACK, 4); break;
+
+        case OP_CMP4: emitCompare(x, 4, true, false); break;
+        case OP_CMP8: emitCompare(x, 8, true, false); break;
+        case OP_ICMP4: emitCompare(x, 4, true, true); break;
+        case OP_ICMP8: emitCompare(x, 8, true, true); break;
+        case OP_IUCMP4: emitCompare(x, 4, false, false); break;
+        case OP_IUCMP8: emitCompare(x, 8, false, false); break;
+        case OP_IUCMPR4: emitCompare(x, 4, false, true); break;
+        case OP_IUCMPR8: emitCompare(x, 8, false, true); break;
+
+        case OP_GOTO: jumps.push_back(std::make_pair(x.jump(), target)); break;
+        case OP_IF: case OP_IFN:
+            x.subImmediate(true, STACK, 4);
+            x.load(false, RAX, STACK, 0);
+            x.alu(ALU_TEST, false, RAX, RAX);
+            jumps.push_back(std::make_pair(x.jump(opcode == OP_IF ? CC_NE : CC_E), target));
+            break;
+
+        case OP_CALL:
+            x.alu(ALU_MOV, true, RDI, CONTEXT);
+            x.alu(ALU_MOV, true, RSI, STACK);
+            x.lea(RDX, LOCALS, function->frameSize);
+            x.moveImmediate(RCX, operand);
+            callHelper(x, (const void*) &jitCall);
+            break;
+        case OP_NATIVE:
+            x.alu(ALU_MOV, true, RDI, CONTEXT);
+            x.alu(ALU_MOV, true, RSI, STACK);
+            x.moveImmediate(RDX, operand);
+            callHelper(x, (const void*) &jitNative);
+            break;
+        case OP_RETURN: returns.push_back(x.jump()); break;
+
+        default:
+            x.alu(ALU_MOV, true, RDI, CONTEXT);
+            x.alu(ALU_MOV, true, RSI, STACK);
+            x.moveImmediate(RDX, opcode);
+            callHelper(x, (const void*) &jitStep);
+            break;
+        }
+
+        if(opcode == OP_CALL || opcode == OP_NATIVE)
+        {
+            x.lea(RAX, STACK, slack);
+            x.alu(ALU_CMP, true, RAX, STACK_END);
+            overflows.push_back(x.jump(CC_A));
+            if(!function->isVerified) checkFloor(function->floors[i + 1]);
+        }
+    }
+
+    size_t epilogue = x.position();
+    x.alu(ALU_MOV, true, RAX, STACK);
+    x.pop(R15);
+    x.pop(R14);
+    x.pop(R13);
+    x.pop(R12);
+    x.pop(RBX);
+    x.ret();
+
+    size_t overflow = x.position();
+    x.alu(ALU_MOV, true, RDI, CONTEXT);
+    x.moveImmediate(RAX, (u64) (uintptr_t) &jitOverflow);
+    x.call(RAX);
+
+    size_t underflow = x.position();
+    x.alu(ALU_MOV, true, RDI, CONTEXT);
+    x.moveImmediate(RAX, (u64) (uintptr_t) &jitUnderflow);
+    x.call(RAX);
+
+    for(std::vector<std::pair<size_t, u32> >::iterator i = jumps.begin(); i != jumps.end(); i++)
+        x.patch(i->first, offsets[i->second]);
+    for(std::vector<size_t>::iterator i = returns.begin(); i != returns.end(); i++)
+        x.patch(*i, epilogue);
+    for(std::vector<size_t>::iterator i = overflows.begin(); i != overflows.end(); i++)
+        x.patch(*i, overflow);
+    for(std::vector<size_t>::iterator i = underflows.begin(); i != underflows.end(); i++)
+        x.patch(*i, underflow);
+
+    function->native = (JitCode) m_executable.store(code.data(), code.size());
+#endif
+}
@@ -0,0 +1,188 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: jit.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef JIT_A11_H_
+#define JIT_A11_H_
+
+#include <vector>
+
+#include "../common.h"
+#include "../emitter.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_X64
+#endif
+
+#define JIT_CHUNK_SIZE      (1 << 20)
+#define JIT_CALL_DEPTH      (1 << 14)
+
+enum RegisterX64
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum ConditionX64
+{
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+    CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+};
+
+#define ALU_ADD     0x01
+#define ALU_OR      0x09
+#define ALU_AND     0x21
+#define ALU_SUB     0x29
+#define ALU_XOR     0x31
+#define ALU_CMP     0x39
+#define ALU_TEST    0x85
+#define ALU_MOV     0x89
+
+#define SSE_SINGLE  0xF3
+#define SSE_DOUBLE  0xF2
+#define SSE_LOAD    0x10
+#define SSE_STORE   0x11
+#define SSE_ADD     0x58
+#define SSE_MUL     0x59
+#define SSE_SUB     0x5C
+#define SSE_DIV     0x5E
+
+class AssemblerX64
+{
+public:
+    AssemblerX64(Emitter* code): m_code(code) {}
+
+    inline size_t position() { return m_code->size(); }
+
+    inline void load(bool wide, u8 reg, u8 base, i32 disp) { rex(wide, reg, base); byte(0x8B); memory(reg, base, disp); }
+    inline void store(bool wide, u8 base, i32 disp, u8 reg) { rex(wide, reg, base); byte(0x89); memory(reg, base, disp); }
+    inline void lea(u8 reg, u8 base, i32 disp) { rex(true, reg, base); byte(0x8D); memory(reg, base, disp); }
+
+    inline void storeImmediate(u8 base, i32 disp, u32 value)
+    {
+        rex(false, 0, base);
+        byte(0xC7);
+        memory(0, base, disp);
+        m_code->write(&value, 4);
+    }
+
+    inline void moveImmediate(u8 reg, u64 value)
+    {
+        rex(true, 0, reg, true);
+        byte(0xB8 + (reg & 7));
+        m_code->write(&value, 8);
+    }
+
+    inline void alu(u8 op, bool wide, u8 dst, u8 src) { rex(wide, src, dst); byte(op); direct(src, dst); }
+    inline void alu8(u8 op, u8 dst, u8 src) { byte(op - 1); direct(src, dst); }
+    inline void imul(bool wide, u8 dst, u8 src) { rex(wide, dst, src); byte(0x0F); byte(0xAF); direct(dst, src); }
+    inline void unary(u8 extension, bool wide, u8 reg) { rex(wide, 0, reg); byte(0xF7); direct(extension, reg); }
+    inline void shift(u8 extension, bool wide, u8 reg) { rex(wide, 0, reg); byte(0xD3); direct(extension, reg); }
+
+    inline void addImmediate(bool wide, u8 reg, i8 value) { rex(wide, 0, reg); byte(0x83); direct(0, reg); byte(value); }
+    inline void subImmediate(bool wide, u8 reg, i8 value) { rex(wide, 0, reg); byte(0x83); direct(5, reg); byte(value); }
+    inline void xorByte(u8 base, i32 disp, u8 value) { rex(false, 0, base); byte(0x80); memory(6, base, disp); byte(value); }
+
+    inline void setcc(u8 condition, u8 reg) { byte(0x0F); byte(0x90 + condition); direct(0, reg); }
+    inline void movzx8(u8 dst, u8 src) { byte(0x0F); byte(0xB6); direct(dst, src); }
+    inline void movsx8(u8 dst, u8 src) { byte(0x0F); byte(0xBE); direct(dst, src); }
+
+    inline void extend(u8 op, bool wide, u8 reg, u8 base, i32 disp)
+    {
+        rex(wide, reg, base);
+        if(op != 0x63) byte(0x0F);
+        byte(op);
+        memory(reg, base, disp);
+    }
+
+    inline void sse(u8 prefix, u8 op, u8 xmm, u8 base, i32 disp)
+    {
+        byte(prefix);
+        rex(false, xmm, base);
+        byte(0x0F);
+        byte(op);
+        memory(xmm, base, disp);
+    }
+
+    inline void push(u8 reg) { rex(false, 0, reg); byte(0x50 + (reg & 7)); }
+    inline void pop(u8 reg) { rex(false, 0, reg); byte(0x58 + (reg & 7)); }
+    inline void call(u8 reg) { rex(false, 0, reg); byte(0xFF); direct(2, reg); }
+    inline void ret() { byte(0xC3); }
+
+    inline size_t jump() { byte(0xE9); return displacement(); }
+    inline size_t jump(u8 condition) { byte(0x0F); byte(0x80 + condition); return displacement(); }
+
+    inline void patch(size_t at, size_t target)
+    {
+        i32 value = (i32) ((i64) target - (i64) (at + 4));
+        std::memcpy(m_code->data() + at, &value, 4);
+    }
+private:
+    Emitter* m_code;
+
+    inline void byte(u8 value) { m_code->writeByte(value); }
+
+    inline void rex(bool wide, u8 reg, u8 base, bool force = false)
+    {
+        u8 prefix = 0x40 | (wide ? 0x08 : 0) | ((reg >> 3) << 2) | (base >> 3);
+        if(prefix != 0x40 || force) byte(prefix);
+    }
+
+    inline void direct(u8 reg, u8 rm) { byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+
+    inline void memory(u8 reg, u8 base, i32 disp)
+    {
+        byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        if((base & 7) == RSP) byte(0x24);
+        m_code->write(&disp, 4);
+    }
+
+    inline size_t displacement()
+    {
+        size_t at = position();
+        i32 zero = 0;
+        m_code->write(&zero, 4);
+        return at;
+    }
+};
+
+class ExecutableMemory
+{
+public:
+    ExecutableMemory(): m_used(JIT_CHUNK_SIZE) {}
+    ExecutableMemory(const ExecutableMemory&) = delete;
+    ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+    ~ExecutableMemory();
+
+    void* store(const u8* code, size_t size);
+private:
+    struct Chunk
+    {
+        u8* data;
+        size_t size;
+    };
+
+    std::vector<Chunk> m_chunks;
+    size_t m_used;
+};
+
+#endif /* JIT_A11_H_ */
@@ -0,0 +1,91 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: layout.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "layout.h"
+
+#include <algorithm>
+
+void VariableLayoutA11::clear()
+{
+    m_variables.clear();
+    m_indices.clear();
+}
+
+VariableLayoutA11::Variable& VariableLayoutA11::variableFor(std::string_view name)
+{
+    u32* index = m_indices.find(name);
+    if(index) return m_variables[*index];
+
+    Variable variable;
+    variable.size = 0;
+    variable.accessc = 0;
+    m_indices.set(name, m_variables.size());
+    m_variables.push_back(variable);
+    return m_variables.back();
+}
+
+void VariableLayoutA11::declare(std::string_view name, u32 size)
+{
+    Variable& variable = variableFor(name);
+    if(!variable.size) variable.size = size;
+}
+
+void VariableLayoutA11::access(std::string_view name)
+{
+    variableFor(name).accessc++;
+}
+
+u32 VariableLayoutA11::assign(SymbolTable* mpos)
+{
+    std::vector<u32> order;
+    for(u32 i = 0; i < m_variables.size(); i++)
+        if(m_variables[i].size) order.push_back(i);
+    std::stable_sort(order.begin(), order.end(), [this](u32 a, u32 b) { return m_variables[a].accessc > m_variables[b].accessc; });
+
+    u32 counter = 0;
+    u32 hole = 0;
+    bool hasHole = false;
+    for(std::vector<u32>::iterator i = order.begin(); i != order.end(); i++)
+    {
+        u32 size = m_variables[*i].size;
+        u32 position;
+        if(size == 4 && hasHole)
+        {
+            position = hole;
+            hasHole = false;
+        }
+        else
+        {
+            if(size == 8 && counter % 8)
+            {
+                hole = counter;
+                hasHole = true;
+                counter += 4;
+            }
+            position = counter;
+            counter += size;
+        }
+        mpos->set(m_indices.getName(*i), position);
+    }
+    return counter;
+}
@@ -0,0 +1,53 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: layout.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef LAYOUT_A11_H_
+#define LAYOUT_A11_H_
+
+#include <string_view>
+#include <vector>
+
+#include "../common.h"
+#include "../symbol_table.h"
+
+class VariableLayoutA11
+{
+public:
+    void clear();
+    void declare(std::string_view name, u32 size);
+    void access(std::string_view name);
+    u32 assign(SymbolTable* mpos);
+private:
+    struct Variable
+    {
+        u32 size;
+        u32 accessc;
+    };
+
+    std::vector<Variable> m_variables;
+    SymbolTable m_indices;
+
+    Variable& variableFor(std::string_view name);
+};
+
+#endif /* LAYOUT_A11_H_ */
@@ -0,0 +1,379 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: optimizer.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "optimizer.h"
+#include "semantics.h"
+
+#define OPTIMIZER_ROUNDS    4
+
+static inline bool isPush(const OperationA11& operation, u32 width)
+{
+    return operation.isImmediate && (operation.is(OP_PUSH4) || operation.is(OP_PUSH8)) && operation.instruction->width == width;
+}
+
+static inline bool isSelfInverse(u8 opcode)
+{
+    switch(opcode)
+    {
+    case OP_SWAP4: case OP_SWAP8:
+    case OP_NEGI4: case OP_NEGI8:
+    case OP_NEGF4: case OP_NEGF8:
+    case OP_BNOT4: case OP_BNOT8:
+        return true;
+    default: return false;
+    }
+}
+
+OptimizerA11::OptimizerA11()
+{
+    m_push4 = findInstructionA11("pushi4");
+    m_push8 = findInstructionA11("pushi8");
+    m_dup4 = findInstructionA11("dup4");
+    m_dup8 = findInstructionA11("dup8");
+    m_if = findInstructionA11("if");
+    m_ifn = findInstructionA11("ifn");
+    m_pop4 = findInstructionA11("pop4");
+}
+
+void OptimizerA11::optimize(OperationsA11* operations)
+{
+    for(u32 round = 0; round < OPTIMIZER_ROUNDS; round++)
+    {
+        size_t size = operations->size();
+        peephole(operations);
+        fold(operations);
+        peephole(operations);
+        if(threadJumps(operations)) peephole(operations);
+        eliminateDeadCode(operations);
+        if(operations->size() == size) break;
+    }
+    allocateLocals(operations);
+}
+
+void OptimizerA11::peephole(OperationsA11* operations)
+{
+    OperationsA11 out;
+    out.reserve(operations->size());
+    for(OperationsA11::iterator i = operations->begin(); i != operations->end(); i++)
+    {
+        if(i->is(OP_NOP)) continue;
+        out.push_back(*i);
+        while(rewriteTail(&out));
+    }
+    operations->swap(out);
+}
+
+bool OptimizerA11::rewriteTail(OperationsA11* out)
+{
+    size_t size = out->size();
+    if(size < 2) return false;
+
+    OperationA11& a = (*out)[size - 2];
+    OperationA11& b = (*out)[size - 1];
+    if(!a.isInstruction() || !b.isInstruction()) return false;
+
+    u8 first = a.instruction->opcode;
+    u8 second = b.instruction->opcode;
+
+    if((second == OP_POP4 && (isPush(a, 4) || first == OP_DUP4))
+    || (second == OP_POP8 && (isPush(a, 8) || first == OP_DUP8))
+    || (first == second && isSelfInverse(first)))
+    {
+        out->resize(size - 2);
+        return true;
+    }
+
+    if((first == OP_LOAD4 && second == OP_FETCH4) || (first == OP_LOAD8 && second == OP_FETCH8))
+    {
+        if(a.operand != b.operand) return false;
+        b = a;
+        a.instruction = first == OP_LOAD4 ? m_dup4 : m_dup8;
+        a.operand = std::string_view();
+        return false;
+    }
+
+    if(first == OP_LNOT4 && (second == OP_IF || second == OP_IFN))
+    {
+        b.instruction = second == OP_IF ? m_ifn : m_if;
+        out->erase(out->end() - 2);
+        return true;
+    }
+
+    if(size >= 3 && first == OP_LNOT4 && second == OP_LNOT4)
+    {
+        OperationA11& c = (*out)[size - 3];
+        if(c.is(OP_LNOT4))
+        {
+            out->resize(size - 2);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void OptimizerA11::fold(OperationsA11* operations)
+{
+    bool isAddressTaken = false;
+    for(OperationsA11::iterator i = operations->begin(); i != operations->end(); i++)
+        if(i->is(OP_VARPTR)) isAddressTaken = true;
+
+    OperationsA11 out;
+    out.reserve(operations->size());
+    m_locals.clear();
+    for(OperationsA11::iterator i = operations->begin(); i != operations->end(); i++)
+    {
+        if(i->isLabel()) m_locals.clear();
+        else if(!isAddressTaken && propagateLocal(&out, *i)) continue;
+
+        out.push_back(*i);
+        while(foldTail(&out));
+    }
+    operations->swap(out);
+}
+
+bool OptimizerA11::foldTail(OperationsA11* out)
+{
+    size_t size = out->size();
+    OperationA11& last = out->back();
+    if(!last.isInstruction()) return false;
+
+    u8 opcode = last.instruction->opcode;
+    if(size >= 3 && (opcode == OP_SWAP4 || opcode == OP_SWAP8))
+    {
+        u32 width = opcode == OP_SWAP4 ? 4 : 8;
+        OperationA11& a = (*out)[size - 3];
+        OperationA11& b = (*out)[size - 2];
+        if(!isPush(a, width) || !isPush(b, width)) return false;
+        std::swap(a, b);
+        out->pop_back();
+        return true;
+    }
+
+    if(size >= 2 && (opcode == OP_DUP4 || opcode == OP_DUP8))
+    {
+        OperationA11& a = (*out)[size - 2];
+        if(!isPush(a, opcode == OP_DUP4 ? 4 : 8)) return false;
+        last = a;
+        return true;
+    }
+
+    ShapeA11 shape;
+    if(!getShapeA11(opcode, &shape) || size < (size_t) shape.operandc + 1) return false;
+
+    u64 operands[2] = { 0, 0 };
+    for(u32 i = 0; i < shape.operandc; i++)
+    {
+        OperationA11& operand = (*out)[size - 1 - shape.operandc + i];
+        if(!isPush(operand, shape.operandWidth)) return false;
+        operands[i] = operand.immediate;
+    }
+
+    u64 result;
+    if(!evaluateA11(opcode, operands, &result)) return false;
+
+    out->resize(size - 1 - shape.operandc);
+    out->push_back(push(shape.resultWidth, result));
+    return true;
+}
+
+bool OptimizerA11::propagateLocal(OperationsA11* out, const OperationA11& operation)
+{
+    if(!operation.isInstruction()) return false;
+
+    u8 opcode = operation.instruction->opcode;
+    if(opcode == OP_LOAD4 || opcode == OP_LOAD8)
+    {
+        u8 width = opcode == OP_LOAD4 ? 4 : 8;
+        for(std::vector<LocalConstant>::iterator i = m_locals.begin(); i != m_locals.end(); i++)
+            if(i->name == operation.operand)
+            {
+                m_locals.erase(i);
+                break;
+            }
+
+        if(!out->empty() && isPush(out->back(), width))
+        {
+            LocalConstant local;
+            local.name = operation.operand;
+            local.width = width;
+            local.value = out->back().immediate;
+            m_locals.push_back(local);
+        }
+        return false;
+    }
+
+    if(opcode == OP_FETCH4 || opcode == OP_FETCH8)
+    {
+        u8 width = opcode == OP_FETCH4 ? 4 : 8;
+        for(std::vector<LocalConstant>::iterator i = m_locals.begin(); i != m_locals.end(); i++)
+            if(i->name == operation.operand && i->width == width)
+            {
+                out->push_back(push(width, i->value));
+                while(foldTail(out));
+                return true;
+            }
+    }
+    return false;
+}
+
+void OptimizerA11::indexLabels(const OperationsA11& operations)
+{
+    m_labelIndices.clear();
+    for(size_t i = 0; i < operations.size(); i++)
+        if(operations[i].isLabel())
+            m_labelIndices.set(operations[i].operand, i);
+}
+
+size_t OptimizerA11::findTarget(const OperationsA11& operations, std::string_view label)
+{
+    u32* index = m_labelIndices.find(label);
+    if(!index) return operations.size();
+
+    size_t target = *index;
+    while(target < operations.size() && !operations[target].isInstruction()) target++;
+    return target;
+}
+
+bool OptimizerA11::isFallthrough(const OperationsA11& operations, size_t index, std::string_view label)
+{
+    u32* target = m_labelIndices.find(label);
+    if(!target || *target <= index) return false;
+    for(size_t i = index + 1; i < *target; i++)
+        if(operations[i].isInstruction()) return false;
+    return true;
+}
+
+bool OptimizerA11::threadJumps(OperationsA11* operations)
+{
+    bool isChanged = false;
+    for(size_t round = 0; round < operations->size(); round++)
+    {
+        OperationsA11& code = *operations;
+        bool isRoundChanged = false;
+        indexLabels(code);
+
+        for(size_t i = 0; i < code.size(); i++)
+        {
+            if(!code[i].isJump()) continue;
+
+            for(size_t hop = 0; hop < code.size(); hop++)
+            {
+                size_t target = findTarget(code, code[i].operand);
+                if(target >= code.size() || target == i) break;
+                if(code[target].is(OP_RETURN) && code[i].is(OP_GOTO))
+                {
+                    code[i] = code[target];
+                    isRoundChanged = true;
+                    break;
+                }
+                if(!code[target].is(OP_GOTO) || code[target].operand == code[i].operand) break;
+                code[i].operand = code[target].operand;
+                isRoundChanged = true;
+            }
+        }
+
+        OperationsA11 out;
+        out.reserve(code.size());
+        for(size_t i = 0; i < code.size(); i++)
+        {
+            OperationA11 operation = code[i];
+            if(operation.isJump() && isFallthrough(code, i, operation.operand))
+            {
+                isRoundChanged = true;
+                if(operation.is(OP_GOTO)) continue;
+                operation.instruction = m_pop4;
+                operation.operand = std::string_view();
+            }
+            else if((operation.is(OP_IF) || operation.is(OP_IFN)) && i + 1 < code.size() && code[i + 1].is(OP_GOTO)
+                 && isFallthrough(code, i + 1, operation.operand))
+            {
+                operation.instruction = operation.is(OP_IF) ? m_ifn : m_if;
+                operation.operand = code[i + 1].operand;
+                isRoundChanged = true;
+                i++;
+            }
+            out.push_back(operation);
+        }
+        code.swap(out);
+
+        if(!isRoundChanged) break;
+        isChanged = true;
+    }
+    return isChanged;
+}
+
+bool OptimizerA11::eliminateDeadCode(OperationsA11* operations)
+{
+    OperationsA11& code = *operations;
+    indexLabels(code);
+
+    std::vector<bool> isReachable(code.size(), false);
+    std::vector<size_t> pending;
+    if(!code.empty()) pending.push_back(0);
+    while(!pending.empty())
+    {
+        size_t i = pending.back();
+        pending.pop_back();
+        for(; i < code.size() && !isReachable[i]; i++)
+        {
+            isReachable[i] = true;
+            const OperationA11& operation = code[i];
+            if(operation.isJump())
+            {
+                u32* target = m_labelIndices.find(operation.operand);
+                if(target) pending.push_back(*target);
+            }
+            if(operation.is(OP_GOTO) || operation.is(OP_RETURN)) break;
+        }
+    }
+
+    SymbolTable& usedLabels = m_labelIndices;
+    usedLabels.clear();
+    for(size_t i = 0; i < code.size(); i++)
+        if(isReachable[i] && code[i].isJump())
+            usedLabels.set(code[i].operand, 0);
+
+    bool isChanged = false;
+    OperationsA11 out;
+    out.reserve(code.size());
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        OperationA11 operation = code[i];
+        if(operation.isLabel() && !usedLabels.find(operation.operand))
+        {
+            isChanged = true;
+            continue;
+        }
+        if(!isReachable[i] && operation.isInstruction())
+        {
+            isChanged = true;
+            OperandA11 operand = operation.instruction->operand;
+            if(operand != OPERAND_LVAR_DEF && operand != OPERAND_GVAR_DEF) continue;
+            operation.isDeclaration = true;
+        }
+        out.push_back(operation);
+    }
+    code.swap(out);
+    return isChanged;
+}
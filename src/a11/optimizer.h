@@ -0,0 +1,123 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: optimizer.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef OPTIMIZER_A11_H_
+#define OPTIMIZER_A11_H_
+
+#include <string_view>
+#include <vector>
+
+#include "../common.h"
+#include "../symbol_table.h"
+#include "instructions.h"
+
+struct OperationA11
+{
+    const InstructionA11* instruction;
+    std::string_view operand;
+    u64 immediate;
+    bool isImmediate;
+    bool isDeclaration;
+    u8 superOpcode;
+    bool isFused;
+    u8 width;
+
+    OperationA11()
+    : instruction(0), immediate(0), isImmediate(false), isDeclaration(false), superOpcode(0), isFused(false), width(0) {}
+
+    inline bool isLabel() const { return instruction == 0; }
+    inline bool isInstruction() const { return instruction != 0 && !isDeclaration; }
+    inline bool is(u8 opcode) const { return isInstruction() && instruction->opcode == opcode; }
+    inline bool isJump() const { return is(OP_GOTO) || is(OP_IF) || is(OP_IFN); }
+};
+
+typedef std::vector<OperationA11> OperationsA11;
+
+class OptimizerA11
+{
+public:
+    OptimizerA11();
+
+    void optimize(OperationsA11* operations);
+private:
+    struct LocalVariable
+    {
+        std::string_view name;
+        u8 size;
+        bool isPinned;
+        size_t begin;
+        size_t end;
+    };
+
+    struct LocalConstant
+    {
+        std::string_view name;
+        u8 width;
+        u64 value;
+    };
+
+    const InstructionA11* m_push4;
+    const InstructionA11* m_push8;
+    const InstructionA11* m_dup4;
+    const InstructionA11* m_dup8;
+    const InstructionA11* m_if;
+    const InstructionA11* m_ifn;
+    const InstructionA11* m_pop4;
+
+    std::vector<LocalConstant> m_locals;
+    SymbolTable m_labelIndices;
+    SymbolTable m_variableIndices;
+    std::vector<LocalVariable> m_variables;
+    StringArena m_slotNameArena;
+    std::vector<std::string_view> m_slotNames[2];
+
+    void peephole(OperationsA11* operations);
+    bool rewriteTail(OperationsA11* out);
+
+    void fold(OperationsA11* operations);
+    bool foldTail(OperationsA11* out);
+    bool propagateLocal(OperationsA11* out, const OperationA11& operation);
+
+    bool threadJumps(OperationsA11* operations);
+    void indexLabels(const OperationsA11& operations);
+    size_t findTarget(const OperationsA11& operations, std::string_view label);
+    bool isFallthrough(const OperationsA11& operations, size_t index, std::string_view label);
+
+    bool eliminateDeadCode(OperationsA11* operations);
+
+    void allocateLocals(OperationsA11* operations);
+    void indexVariables(const OperationsA11& operations);
+    void computeLiveness(const OperationsA11& operations, std::vector<u64>* liveIn, std::vector<u64>* liveOut);
+    std::string_view slotName(u8 size, u32 slot);
+
+    inline OperationA11 push(u8 width, u64 value)
+    {
+        OperationA11 operation;
+        operation.instruction = width == 4 ? m_push4 : m_push8;
+        operation.immediate = value;
+        operation.isImmediate = true;
+        return operation;
+    }
+};
+
+#endif /* OPTIMIZER_A11_H_ */
@@ -0,0 +1,207 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: optimizer_locals.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "optimizer.h"
+
+#include <algorithm>
+#include <string>
+
+#define WORD_BITS   64
+
+static inline bool getLocal(const OperationA11& operation, std::string_view* name)
+{
+    if(operation.isLabel()) return false;
+
+    OperandA11 operand = operation.instruction->operand;
+    if(operand == OPERAND_LVAR || operand == OPERAND_LVAR_DEF)
+    {
+        *name = operation.operand;
+        return true;
+    }
+    if(operand == OPERAND_INT8 && !operation.isImmediate && !operation.operand.empty() && operation.operand[0] == '@')
+    {
+        *name = operation.operand.substr(1);
+        return true;
+    }
+    return false;
+}
+
+static inline bool isDefinition(const OperationA11& operation)
+{
+    return operation.instruction->operand == OPERAND_LVAR_DEF;
+}
+
+static inline bool isUse(const OperationA11& operation)
+{
+    return operation.isInstruction() && operation.instruction->operand != OPERAND_LVAR_DEF;
+}
+
+void OptimizerA11::indexVariables(const OperationsA11& operations)
+{
+    m_variableIndices.clear();
+    m_variables.clear();
+    for(OperationsA11::const_iterator i = operations.begin(); i != operations.end(); i++)
+    {
+        std::string_view name;
+        if(!getLocal(*i, &name)) continue;
+
+        u32* index = m_variableIndices.find(name);
+        if(!index)
+        {
+            LocalVariable variable;
+            variable.name = name;
+            variable.size = i->instruction->varSize;
+            variable.isPinned = !isDefinition(*i);
+            variable.begin = operations.size();
+            variable.end = 0;
+            m_variableIndices.set(name, m_variables.size());
+            m_variables.push_back(variable);
+            index = m_variableIndices.find(name);
+        }
+
+        if(i->is(OP_VARPTR) || i->instruction->operand == OPERAND_INT8)
+            m_variables[*index].isPinned = true;
+    }
+}
+
+void OptimizerA11::computeLiveness(const OperationsA11& operations, std::vector<u64>* liveIn, std::vector<u64>* liveOut)
+{
+    size_t size = operations.size();
+    size_t words = (m_variables.size() + WORD_BITS - 1) / WORD_BITS;
+    liveIn->assign(size * words, 0);
+    liveOut->assign(size * words, 0);
+    indexLabels(operations);
+
+    std::vector<u64> live(words);
+    bool isChanged = true;
+    while(isChanged)
+    {
+        isChanged = false;
+        for(size_t i = size; i-- > 0;)
+        {
+            const OperationA11& operation = operations[i];
+            std::fill(live.begin(), live.end(), 0);
+
+            bool isFallingThrough = !operation.is(OP_GOTO) && !operation.is(OP_RETURN);
+            if(isFallingThrough && i + 1 < size)
+                for(size_t w = 0; w < words; w++)
+                    live[w] |= (*liveIn)[(i + 1) * words + w];
+            if(operation.isJump())
+            {
+                u32* target = m_labelIndices.find(operation.operand);
+                if(target)
+                    for(size_t w = 0; w < words; w++)
+                        live[w] |= (*liveIn)[*target * words + w];
+            }
+            std::copy(live.begin(), live.end(), liveOut->begin() + i * words);
+
+            std::string_view name;
+            if(getLocal(operation, &name))
+            {
+                u32 variable = *m_variableIndices.find(name);
+                u64 bit = 1ull << (variable % WORD_BITS);
+                if(isUse(operation)) live[variable / WORD_BITS] |= bit;
+                else live[variable / WORD_BITS] &= ~bit;
+            }
+
+            if(!std::equal(live.begin(), live.end(), liveIn->begin() + i * words))
+            {
+                std::copy(live.begin(), live.end(), liveIn->begin() + i * words);
+                isChanged = true;
+            }
+        }
+    }
+}
+
+std::string_view OptimizerA11::slotName(u8 size, u32 slot)
+{
+    // Each name is stored once and reused by every later function.
+    std::vector<std::string_view>& names = m_slotNames[size == 8];
+    while(names.size() <= slot)
+    {
+        std::string name = " " + std::to_string(size) + "." + std::to_string(names.size());
+        names.push_back(m_slotNameArena.store(name));
+    }
+    return names[slot];
+}
+
+void OptimizerA11::allocateLocals(OperationsA11* operations)
+{
+    OperationsA11& code = *operations;
+    indexVariables(code);
+    if(m_variables.empty() || code.empty()) return;
+
+    std::vector<u64> liveIn, liveOut;
+    computeLiveness(code, &liveIn, &liveOut);
+
+    size_t words = (m_variables.size() + WORD_BITS - 1) / WORD_BITS;
+    for(u32 v = 0; v < m_variables.size(); v++)
+    {
+        LocalVariable& variable = m_variables[v];
+        u64 bit = 1ull << (v % WORD_BITS);
+        if(liveIn[v / WORD_BITS] & bit) variable.isPinned = true;
+
+        for(size_t i = 0; i < code.size(); i++)
+            if((liveIn[i * words + v / WORD_BITS] | liveOut[i * words + v / WORD_BITS]) & bit)
+            {
+                variable.begin = std::min(variable.begin, i);
+                variable.end = std::max(variable.end, i);
+            }
+    }
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        std::string_view name;
+        if(!getLocal(code[i], &name)) continue;
+        LocalVariable& variable = m_variables[*m_variableIndices.find(name)];
+        variable.begin = std::min(variable.begin, i);
+        variable.end = std::max(variable.end, i);
+    }
+
+    std::vector<u32> order;
+    for(u32 v = 0; v < m_variables.size(); v++)
+        if(!m_variables[v].isPinned) order.push_back(v);
+    std::stable_sort(order.begin(), order.end(), [this](u32 a, u32 b) { return m_variables[a].begin < m_variables[b].begin; });
+
+    std::vector<std::string_view> slots(m_variables.size());
+    std::vector<size_t> slotEnds[2];
+    for(std::vector<u32>::iterator v = order.begin(); v != order.end(); v++)
+    {
+        LocalVariable& variable = m_variables[*v];
+        std::vector<size_t>& ends = slotEnds[variable.size == 8];
+
+        u32 slot = 0;
+        while(slot < ends.size() && ends[slot] >= variable.begin) slot++;
+        if(slot == ends.size()) ends.push_back(0);
+        ends[slot] = variable.end;
+        slots[*v] = slotName(variable.size, slot);
+    }
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        std::string_view name;
+        if(!getLocal(code[i], &name)) continue;
+        u32 variable = *m_variableIndices.find(name);
+        if(!m_variables[variable].isPinned) code[i].operand = slots[variable];
+    }
+}
@@ -0,0 +1,225 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: semantics.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef SEMANTICS_A11_H_
+#define SEMANTICS_A11_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "../common.h"
+#include "instructions.h"
+
+struct ShapeA11
+{
+    u8 operandc;
+    u8 operandWidth;
+    u8 resultWidth;
+};
+
+inline bool getShapeA11(u8 opcode, ShapeA11* shape)
+{
+    switch(opcode)
+    {
+    case OP_ADDI4: case OP_ADDF4: case OP_SUBI4: case OP_SUBF4: case OP_MULI4: case OP_MULF4:
+    case OP_DIVI4: case OP_DIVU4: case OP_DIVF4: case OP_REMI4: case OP_REMU4:
+    case OP_SHL4: case OP_SHR4: case OP_SHRU4: case OP_BAND4: case OP_BXOR4: case OP_BOR4:
+    case OP_LAND4: case OP_LOR4:
+        *shape = { 2, 4, 4 }; return true;
+    case OP_ADDI8: case OP_ADDF8: case OP_SUBI8: case OP_SUBF8: case OP_MULI8: case OP_MULF8:
+    case OP_DIVI8: case OP_DIVU8: case OP_DIVF8: case OP_REMI8: case OP_REMU8:
+    case OP_SHL8: case OP_SHR8: case OP_SHRU8: case OP_BAND8: case OP_BXOR8: case OP_BOR8:
+    case OP_LAND8: case OP_LOR8:
+        *shape = { 2, 8, 8 }; return true;
+    case OP_CMP4: case OP_IUCMP4: case OP_IUCMPR4: case OP_FCMP4:
+        *shape = { 2, 4, 4 }; return true;
+    case OP_CMP8: case OP_IUCMP8: case OP_IUCMPR8: case OP_FCMP8:
+        *shape = { 2, 8, 4 }; return true;
+    case OP_NEGI4: case OP_NEGF4: case OP_BNOT4: case OP_LNOT4:
+    case OP_CI14: case OP_CI24: case OP_CI41: case OP_CI42: case OP_CFI4: case OP_CIF4:
+    case OP_LTNL: case OP_LENL: case OP_GTNL: case OP_GENL: case OP_EQNL: case OP_NENL:
+        *shape = { 1, 4, 4 }; return true;
+    case OP_NEGI8: case OP_NEGF8: case OP_BNOT8: case OP_LNOT8: case OP_CFI8: case OP_CIF8:
+        *shape = { 1, 8, 8 }; return true;
+    case OP_CI48: case OP_CF48:
+        *shape = { 1, 4, 8 }; return true;
+    case OP_CI84: case OP_CF84:
+        *shape = { 1, 8, 4 }; return true;
+    default: return false;
+    }
+}
+
+template<typename T, typename B>
+inline T fromBitsA11(B bits)
+{
+    T value;
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+template<typename T>
+inline u64 toBitsA11(T value)
+{
+    u64 bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    return bits;
+}
+
+template<typename T>
+inline i32 compareA11(T a, T b)
+{
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+template<typename F, typename I>
+inline bool isTruncatableA11(F value)
+{
+    const F limit = std::ldexp((F) 1, sizeof(I) * 8 - 1);
+    return value >= -limit && value < limit;
+}
+
+template<typename F, typename I>
+inline I truncateA11(F value)
+{
+    return isTruncatableA11<F, I>(value) ? (I) value : std::numeric_limits<I>::min();
+}
+
+template<typename T>
+inline u32 compareNaNA11(T a, T b, i32 nan)
+{
+    bool isNaNA = std::isnan(a), isNaNB = std::isnan(b);
+    if(isNaNA || isNaNB) return isNaNA == isNaNB ? 0 : (u32) (isNaNA ? nan : -nan);
+    return (u32) compareA11(a, b);
+}
+
+inline bool evaluateA11(u8 opcode, const u64* operands, u64* result)
+{
+    u32 a4 = (u32) operands[0], b4 = (u32) operands[1];
+    u64 a8 = operands[0], b8 = operands[1];
+    i32 ai4 = (i32) a4, bi4 = (i32) b4;
+    i64 ai8 = (i64) a8, bi8 = (i64) b8;
+    f32 af4 = fromBitsA11<f32>(a4), bf4 = fromBitsA11<f32>(b4);
+    f64 af8 = fromBitsA11<f64>(a8), bf8 = fromBitsA11<f64>(b8);
+
+    switch(opcode)
+    {
+    case OP_ADDI4: *result = (u32) (a4 + b4); return true;
+    case OP_ADDI8: *result = a8 + b8; return true;
+    case OP_ADDF4: *result = toBitsA11(af4 + bf4); return true;
+    case OP_ADDF8: *result = toBitsA11(af8 + bf8); return true;
+    case OP_SUBI4: *result = (u32) (a4 - b4); return true;
+    case OP_SUBI8: *result = a8 - b8; return true;
+    case OP_SUBF4: *result = toBitsA11(af4 - bf4); return true;
+    case OP_SUBF8: *result = toBitsA11(af8 - bf8); return true;
+    case OP_MULI4: *result = (u32) (a4 * b4); return true;
+    case OP_MULI8: *result = a8 * b8; return true;
+    case OP_MULF4: *result = toBitsA11(af4 * bf4); return true;
+    case OP_MULF8: *result = toBitsA11(af8 * bf8); return true;
+    case OP_DIVI4:
+        if(bi4 == 0 || (ai4 == INT32_MIN && bi4 == -1)) return false;
+        *result = (u32) (ai4 / bi4); return true;
+    case OP_DIVI8:
+        if(bi8 == 0 || (ai8 == INT64_MIN && bi8 == -1)) return false;
+        *result = (u64) (ai8 / bi8); return true;
+    case OP_DIVU4: if(b4 == 0) return false; *result = a4 / b4; return true;
+    case OP_DIVU8: if(b8 == 0) return false; *result = a8 / b8; return true;
+    case OP_DIVF4: *result = toBitsA11(af4 / bf4); return true;
+    case OP_DIVF8: *result = toBitsA11(af8 / bf8); return true;
+    case OP_REMI4:
+        if(bi4 == 0 || (ai4 == INT32_MIN && bi4 == -1)) return false;
+        *result = (u32) (ai4 % bi4); return true;
+    case OP_REMI8:
+        if(bi8 == 0 || (ai8 == INT64_MIN && bi8 == -1)) return false;
+        *result = (u64) (ai8 % bi8); return true;
+    case OP_REMU4: if(b4 == 0) return false; *result = a4 % b4; return true;
+    case OP_REMU8: if(b8 == 0) return false; *result = a8 % b8; return true;
+    case OP_NEGI4: *result = (u32) (0u - a4); return true;
+    case OP_NEGI8: *result = 0ull - a8; return true;
+    case OP_NEGF4: *result = toBitsA11(-af4); return true;
+    case OP_NEGF8: *result = toBitsA11(-af8); return true;
+
+    case OP_SHL4: if(b4 >= 32) return false; *result = (u32) (a4 << b4); return true;
+    case OP_SHL8: if(b8 >= 64) return false; *result = a8 << b8; return true;
+    case OP_SHR4: if(b4 >= 32) return false; *result = (u32) (ai4 >> b4); return true;
+    case OP_SHR8: if(b8 >= 64) return false; *result = (u64) (ai8 >> b8); return true;
+    case OP_SHRU4: if(b4 >= 32) return false; *result = a4 >> b4; return true;
+    case OP_SHRU8: if(b8 >= 64) return false; *result = a8 >> b8; return true;
+    case OP_BNOT4: *result = (u32) ~a4; return true;
+    case OP_BNOT8: *result = ~a8; return true;
+    case OP_BAND4: *result = a4 & b4; return true;
+    case OP_BAND8: *result = a8 & b8; return true;
+    case OP_BXOR4: *result = a4 ^ b4; return true;
+    case OP_BXOR8: *result = a8 ^ b8; return true;
+    case OP_BOR4: *result = a4 | b4; return true;
+    case OP_BOR8: *result = a8 | b8; return true;
+
+    case OP_LNOT4: *result = a4 == 0; return true;
+    case OP_LNOT8: *result = a8 == 0; return true;
+    case OP_LAND4: *result = a4 != 0 && b4 != 0; return true;
+    case OP_LAND8: *result = a8 != 0 && b8 != 0; return true;
+    case OP_LOR4: *result = a4 != 0 || b4 != 0; return true;
+    case OP_LOR8: *result = a8 != 0 || b8 != 0; return true;
+
+    case OP_CI14: *result = (u32) (i32) (i8) a4; return true;
+    case OP_CI24: *result = (u32) (i32) (i16) a4; return true;
+    case OP_CI41: *result = (u8) a4; return true;
+    case OP_CI42: *result = (u16) a4; return true;
+    case OP_CI48: *result = (u64) (i64) ai4; return true;
+    case OP_CI84: *result = (u32) a8; return true;
+    case OP_CF48: *result = toBitsA11((f64) af4); return true;
+    case OP_CF84: *result = toBitsA11((f32) af8); return true;
+    case OP_CFI4:
+        if(!isTruncatableA11<f32, i32>(af4)) return false;
+        *result = (u32) (i32) af4; return true;
+    case OP_CFI8:
+        if(!isTruncatableA11<f64, i64>(af8)) return false;
+        *result = (u64) (i64) af8; return true;
+    case OP_CIF4: *result = toBitsA11((f32) ai4); return true;
+    case OP_CIF8: *result = toBitsA11((f64) ai8); return true;
+
+    case OP_CMP4: *result = (u32) compareA11(ai4, bi4); return true;
+    case OP_CMP8: *result = (u32) compareA11(ai8, bi8); return true;
+    case OP_IUCMP4: *result = (u32) compareA11(a4, b4); return true;
+    case OP_IUCMP8: *result = (u32) compareA11(a8, b8); return true;
+    case OP_IUCMPR4: *result = (u32) compareA11(b4, a4); return true;
+    case OP_IUCMPR8: *result = (u32) compareA11(b8, a8); return true;
+    case OP_FCMP4:
+        if(std::isnan(af4) || std::isnan(bf4)) return false;
+        *result = (u32) compareA11(af4, bf4); return true;
+    case OP_FCMP8:
+        if(std::isnan(af8) || std::isnan(bf8)) return false;
+        *result = (u32) compareA11(af8, bf8); return true;
+
+    case OP_LTNL: *result = ai4 < 0; return true;
+    case OP_LENL: *result = ai4 <= 0; return true;
+    case OP_GTNL: *result = ai4 > 0; return true;
+    case OP_GENL: *result = ai4 >= 0; return true;
+    case OP_EQNL: *result = ai4 == 0; return true;
+    case OP_NENL: *result = ai4 != 0; return true;
+    default: return false;
+    }
+}
+
+#endif /* SEMANTICS_A11_H_ */
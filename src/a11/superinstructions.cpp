@@ -0,0 +1,122 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: superinstructions.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "superinstructions.h"
+
+#include <algorithm>
+#include <string>
+
+static inline bool isMoreProfitable(const OpcodeProfile::Sequence& a, const OpcodeProfile::Sequence& b)
+{
+    u64 savedA = a.count * (a.opcodes.size() - 1);
+    u64 savedB = b.count * (b.opcodes.size() - 1);
+    if(savedA != savedB) return savedA > savedB;
+    return a.opcodes < b.opcodes;
+}
+
+static inline std::string_view keyFor(const u8* opcodes, u32 length)
+{
+    return std::string_view(reinterpret_cast<const char*>(opcodes), length);
+}
+
+bool SuperinstructionsA11::isFusable(const std::vector<u8>& opcodes)
+{
+    if(opcodes.size() < 2 || opcodes.size() > SUPERINSTRUCTION_LENGTH) return false;
+    for(u32 i = 0; i < opcodes.size(); i++)
+    {
+        if(!findInstructionA11(opcodes[i])) return false;
+        if(i + 1 < opcodes.size() && isControlFlowA11(opcodes[i])) return false;
+    }
+    return !m_lookup.find(keyFor(opcodes.data(), opcodes.size()));
+}
+
+void SuperinstructionsA11::clear()
+{
+    m_selected.clear();
+    m_lookup.clear();
+}
+
+void SuperinstructionsA11::select(const OpcodeProfile& profile, u32 limit)
+{
+    clear();
+
+    std::vector<OpcodeProfile::Sequence> candidates = profile.getSequences();
+    std::stable_sort(candidates.begin(), candidates.end(), isMoreProfitable);
+
+    u32 opcode = 0xFF;
+    for(std::vector<OpcodeProfile::Sequence>::iterator i = candidates.begin(); i != candidates.end(); i++)
+    {
+        if(m_selected.size() >= limit || i->count == 0) break;
+        if(!isFusable(i->opcodes)) continue;
+
+        while(opcode > 0 && findInstructionA11((u8) opcode)) opcode--;
+        if(opcode == 0) break;
+
+        SuperinstructionA11 superinstruction;
+        superinstruction.opcode = opcode--;
+        superinstruction.length = i->opcodes.size();
+        std::fill(superinstruction.components, superinstruction.components + SUPERINSTRUCTION_LENGTH, OP_NOP);
+        std::copy(i->opcodes.begin(), i->opcodes.end(), superinstruction.components);
+
+        m_lookup.set(keyFor(superinstruction.components, superinstruction.length), m_selected.size());
+        m_selected.push_back(superinstruction);
+    }
+}
+
+void SuperinstructionsA11::apply(OperationsA11* operations)
+{
+    OperationsA11& code = *operations;
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        u8 opcodes[SUPERINSTRUCTION_LENGTH];
+        u32 length = 0;
+        while(length < SUPERINSTRUCTION_LENGTH && i + length < code.size() && code[i + length].isInstruction())
+        {
+            opcodes[length] = code[i + length].instruction->opcode;
+            length++;
+        }
+
+        for(; length >= 2; length--)
+        {
+            u32* index = m_lookup.find(keyFor(opcodes, length));
+            if(!index) continue;
+
+            code[i].superOpcode = m_selected[*index].opcode;
+            for(u32 j = 1; j < length; j++)
+                code[i + j].isFused = true;
+            i += length - 1;
+            break;
+        }
+    }
+}
+
+void SuperinstructionsA11::writeTable(Emitter* out) const
+{
+    out->writeByte(m_selected.size());
+    for(std::vector<SuperinstructionA11>::const_iterator i = m_selected.begin(); i != m_selected.end(); i++)
+    {
+        out->writeByte(i->opcode);
+        out->writeByte(i->length);
+        out->write(i->components, SUPERINSTRUCTION_LENGTH);
+    }
+}
@@ -0,0 +1,62 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: superinstructions.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef SUPERINSTRUCTIONS_A11_H_
+#define SUPERINSTRUCTIONS_A11_H_
+
+#include <vector>
+
+#include "../common.h"
+#include "../emitter.h"
+#include "../profile.h"
+#include "../symbol_table.h"
+#include "optimizer.h"
+
+#define SUPERINSTRUCTION_LIMIT      32
+#define SUPERINSTRUCTION_LENGTH     3
+
+struct SuperinstructionA11
+{
+    u8 opcode;
+    u8 length;
+    u8 components[SUPERINSTRUCTION_LENGTH];
+};
+
+class SuperinstructionsA11
+{
+public:
+    void select(const OpcodeProfile& profile, u32 limit);
+    void apply(OperationsA11* operations);
+    void clear();
+
+    inline bool isEmpty() const { return m_selected.empty(); }
+    inline u32 getTableSize() const { return 1 + m_selected.size() * (2 + SUPERINSTRUCTION_LENGTH); }
+    void writeTable(Emitter* out) const;
+private:
+    std::vector<SuperinstructionA11> m_selected;
+    SymbolTable m_lookup;
+
+    bool isFusable(const std::vector<u8>& opcodes);
+};
+
+#endif /* SUPERINSTRUCTIONS_A11_H_ */
@@ -24,55 +24,93 @@
 #include "translator.h"
 
 #include <iostream>
+#include <unordered_map>
 
 void TranslatorA11::function()
 {
-    if(m_scanner->getToken().size() > 2)
+    if(m_scanner->token().size() > 2)
         m_log->abort("invalid function def \"" + m_scanner->getToken() + "\"");
 
     m_scanner->nextTokenEOF();
-    std::string name = m_scanner->getToken();
+    std::string_view name = m_scanner->token();
 
-    if(m_functionIDs.find(name) == m_functionIDs.end())
-        m_functionIDs[name] = nextFunctionID();
-    else m_log->abort("function \"" + name + "\" redeclared");
+    if(m_functionIDs.find(name))
+        m_log->abort("function \"" + std::string(name) + "\" redeclared");
+    u32 id = functionIDFor(name, true);
+    if(m_functions.size() < m_functionIDCounter) m_functions.resize(m_functionIDCounter);
 
-    if(name == "main") m_main = m_functionIDs[name];
+    if(name == "main") m_main = id;
 
-    m_lvarMPosCounter = 0;
-    m_lvarMPos.clear();
-
-    passFunction(m_functionIDs[name]);
+    if(m_singlePass) encodeFunction(id, &m_context);
+    else passFunction(id);
 }
 
 void TranslatorA11::native()
 {
-    if(m_scanner->getToken().size() > 2)
+    if(m_scanner->token().size() > 2)
         m_log->abort("invalid native def \"" + m_scanner->getToken() + "\"");
 
     m_scanner->nextTokenEOF();
-    std::string name = m_scanner->getToken();
+    std::string_view token = m_scanner->token();
+    std::string_view name = nativeName(token);
+
+    if(m_nativeIDs.find(name))
+        m_log->abort("native \"" + std::string(name) + "\" redeclared");
+    nativeIDFor(name, true);
+
+    u32 argumentBytes, resultBytes;
+    bool hasSignature = parseNativeSignature(m_log, token, &argumentBytes, &resultBytes);
+    if(m_verify) m_verifier.addNative(name, hasSignature, argumentBytes, resultBytes);
+
+    m_nativeFunctions.push_back(std::string(name));
+}
 
-    if(m_nativeIDs.find(name) == m_nativeIDs.end())
-        m_nativeIDs[name] = nextNativeID();
-    else m_log->abort("native \"" + name + "\" redeclared");
+bool TranslatorA11::parseNativeSignature(Log* log, std::string_view token, u32* argumentBytes, u32* resultBytes)
+{
+    std::string_view name = nativeName(token);
+    *argumentBytes = 0;
+    *resultBytes = 0;
+    if(name.size() == token.size()) return false;
 
-    m_nativeFunctions.push_back(name);
+    std::string_view signature = token.substr(name.size() + 1);
+    size_t comma = signature.find(',');
+    if(comma == std::string_view::npos || signature.back() != ')')
+        log->abort("invalid native signature \"" + std::string(token) + "\"");
+    i64 arguments = parseInteger(signature.substr(0, comma));
+    i64 results = parseInteger(signature.substr(comma + 1, signature.size() - comma - 2));
+    if(arguments < 0 || arguments % 4 || arguments >= 0xFFFF || results < 0 || results % 4 || results >= 0xFFFF)
+        log->abort("invalid native signature \"" + std::string(token) + "\"");
+    *argumentBytes = arguments;
+    *resultBytes = results;
+    return true;
 }
 
 void TranslatorA11::globalvar()
 {
     m_scanner->nextTokenEOF();
-    std::string amltype = m_scanner->getToken();
+    std::string_view amltype = m_scanner->token();
     u32 size = 0;
     if(amltype == "i4") size = 4;
     else if(amltype == "i8") size = 8;
     else if(amltype == "f4") size = 4;
     else if(amltype == "f8") size = 8;
-    else m_log->abort("invalid AML type " + amltype);
+    else m_log->abort("invalid AML type " + std::string(amltype));
     m_scanner->nextTokenEOF();
-    std::string name = m_scanner->getToken();
-    gvarMPosFor(name, true, size);
+    if(m_layout) m_globals.declare(m_scanner->token(), size);
+    else gvarMPosFor(m_scanner->token(), true, size);
+}
+
+u32 TranslatorA11::getOutputSize()
+{
+    u32 size = 6 + 4 + 4 + 4 + 4;
+    if(!m_superinstructions.isEmpty())
+        size += m_superinstructions.getTableSize();
+    for(u32 i = 0; i < m_nativeIDCounter; i++)
+        size += m_nativeFunctions[i].size() + 1;
+    for(u32 i = 0; i < m_functionIDCounter; i++)
+        size += (m_verify ? 12 : 4) + getFunctionSize(i);
+    if(m_indexed) size += 12 * m_nativeIDCounter + ABY_FUNCTION_ALIGNMENT * m_functionIDCounter + ABY_PAGE_SIZE + 16;
+    return size;
 }
 
 void TranslatorA11::writeHeader()
@@ -83,9 +121,19 @@ void TranslatorA11::writeHeader()
     writeByte(27);
 
     u16 version = 0;
+    if(!m_superinstructions.isEmpty()) version |= ABY_SUPERINSTRUCTIONS;
+    if(m_compact) version |= ABY_COMPACT;
+    if(m_verify) version |= ABY_FRAMES;
+    if(m_indexed) version |= ABY_INDEXED;
     write(&version, 2);
 
     m_filepos += 6;
+
+    if(version & ABY_SUPERINSTRUCTIONS)
+    {
+        m_superinstructions.writeTable(m_out);
+        m_filepos += m_superinstructions.getTableSize();
+    }
 }
 
 void TranslatorA11::writeNativeData()
@@ -106,6 +154,13 @@ void TranslatorA11::writeNativeData()
 
 void TranslatorA11::writeFunctions()
 {
+    bool isEncoded = m_singlePass;
+    if(!isEncoded && m_threadc > 1 && m_scanner->hasBuffer())
+    {
+        encodeFunctionsParallel();
+        isEncoded = true;
+    }
+
     u32 functionc = m_functionIDCounter;
     write(&functionc, 4);
     m_filepos += 4;
@@ -115,25 +170,113 @@ void TranslatorA11::writeFunctions()
         u32 size = getFunctionSize(i);
         write(&size, 4);
         m_filepos += 4;
-        writeFunction(i);
+        if(m_verify)
+        {
+            u32 frameSize = getFrameSize(i);
+            u32 maxStack = m_verifier.getFrame(i).high;
+            write(&frameSize, 4);
+            write(&maxStack, 4);
+            m_filepos += 8;
+        }
+        writeFunctionCode(i, isEncoded);
     }
 
     write(&m_main, 4);
 }
 
+void TranslatorA11::writeFunctionCode(u32 id, bool isEncoded)
+{
+    if(isEncoded) write(m_functions[id].code.data(), getFunctionSize(id));
+    else if(m_cache && m_scanner->hasBuffer() && !m_compact) writeFunctionCached(id);
+    else writeFunction(id, &m_context);
+}
+
 void TranslatorA11::writeGlobalvarData()
 {
     write(&m_gvarMPosCounter, 4);
     m_filepos += 4;
 }
 
+void TranslatorA11::writeIndex(size_t base)
+{
+    u32 nativec = m_nativeIDCounter;
+    u32 functionc = m_functionIDCounter;
+    u32 entrySize = m_verify ? 16 : 8;
+
+    std::string pool;
+    std::unordered_map<std::string, u32> strings;
+    std::vector<u32> names;
+    for(u32 i = 0; i < nativec; i++)
+    {
+        const std::string& name = m_nativeFunctions[i];
+        std::unordered_map<std::string, u32>::iterator string = strings.find(name);
+        if(string == strings.end())
+        {
+            string = strings.insert(std::make_pair(name, (u32) pool.size())).first;
+            pool += name;
+            pool += '\0';
+        }
+        names.push_back(string->second);
+    }
+
+    u32 poolOffset = m_out->size() - base + 24 + nativec * 12 + functionc * entrySize;
+    u32 poolSize = pool.size();
+    write(&nativec, 4);
+    write(&functionc, 4);
+    write(&m_main, 4);
+    write(&m_gvarMPosCounter, 4);
+    write(&poolOffset, 4);
+    write(&poolSize, 4);
+
+    for(u32 i = 0; i < nativec; i++)
+    {
+        u32 nameSize = m_nativeFunctions[i].size();
+        u32 hash = hashNameA11(m_nativeFunctions[i]);
+        write(&names[i], 4);
+        write(&nameSize, 4);
+        write(&hash, 4);
+    }
+
+    size_t table = m_out->size();
+    for(u32 i = 0; i < functionc; i++)
+    {
+        u32 entry[4] = { 0, getFunctionSize(i), 0, 0 };
+        if(m_verify)
+        {
+            entry[2] = getFrameSize(i);
+            entry[3] = m_verifier.getFrame(i).high;
+        }
+        write(entry, entrySize);
+    }
+
+    write(pool.data(), pool.size());
+
+    bool isEncoded = m_singlePass;
+    if(!isEncoded && m_threadc > 1 && m_scanner->hasBuffer())
+    {
+        encodeFunctionsParallel();
+        isEncoded = true;
+    }
+
+    u32 alignment = ABY_PAGE_SIZE;
+    for(u32 i = 0; i < functionc; i++)
+    {
+        while((m_out->size() - base) % alignment) writeByte(0x00);
+        alignment = ABY_FUNCTION_ALIGNMENT;
+
+        u32 offset = m_out->size() - base;
+        m_out->patch(table + i * entrySize, &offset, 4);
+        writeFunctionCode(i, isEncoded);
+    }
+}
+
 void TranslatorA11::labelPass()
 {
-    while(m_scanner->nextToken())
+    while(m_scanner->advance())
     {
-        std::string token = m_scanner->getToken();
+        std::string_view token = m_scanner->token();
         if(token.length() < 2 || token[1] != ':')
-            m_log->abort("invalid block def \"" + token + "\"");
+            m_log->abort("invalid block def \"" + std::string(token) + "\"");
 
         switch(token[0])
         {
@@ -142,12 +285,119 @@ void TranslatorA11::labelPass()
         case 'w': globalvar(); break;
         }
     }
+
+    if(m_verify) verifyFunctions();
+    if(m_layout) layoutGlobals();
+    if(m_compact)
+        for(u32 i = 0; i < m_functionIDCounter; i++)
+        {
+            resolveFunction(i);
+            relaxFunction(i);
+        }
 }
 
 void TranslatorA11::translationPass()
 {
+    if(m_singlePass) patchFixups(&m_context.symbolFixups);
+    m_out->reserve(m_out->size() + getOutputSize());
+
+    size_t base = m_out->size();
     writeHeader();
+    if(m_indexed)
+    {
+        writeIndex(base);
+        return;
+    }
     writeNativeData();
     writeFunctions();
     writeGlobalvarData();
 }
+
+bool TranslatorA11::reset(Log* log, Scanner* scanner, Emitter* out)
+{
+    m_log = log;
+    m_scanner = scanner;
+    m_out = out;
+    m_pc = 0;
+    m_filepos = 0;
+    m_main = 0;
+
+    m_functionIDCounter = 0;
+    m_nativeIDCounter = 0;
+    m_gvarMPosCounter = 0;
+    m_lvarMPosCounter = 0;
+    m_functionIDs.clear();
+    m_nativeIDs.clear();
+    m_gvarMPos.clear();
+    m_lvarIDs.clear();
+    m_locals.clear();
+    m_labels.clear();
+    m_globals.clear();
+
+    for(std::vector<FunctionData>::iterator function = m_functions.begin(); function != m_functions.end(); function++)
+    {
+        function->inpos = 0;
+        function->endpos = 0;
+        function->size = 0;
+        function->code.clear();
+        function->operations.clear();
+    }
+    m_nativeFunctions.clear();
+    m_singlePass = false;
+
+    m_threadc = 1;
+    m_cache = 0;
+    m_cacheSalt.clear();
+    m_optimize = false;
+    m_compact = false;
+    m_layout = false;
+    m_verify = false;
+    m_indexed = false;
+    m_superinstructions.clear();
+
+    m_context.log = log;
+    m_context.scanner = scanner;
+    m_context.code = out;
+    m_context.isDeferring = false;
+    m_context.lvarMPos.clear();
+    m_context.lvarMPosCounter = 0;
+    m_context.labelFixups.clear();
+    m_context.symbolFixups.clear();
+    m_context.references = 0;
+    m_context.layout.clear();
+
+    m_verifier.clear();
+    m_verifier.setLog(log);
+    m_operands.clear();
+    return true;
+}
+
+void TranslatorA11::setOptions(TranslatorOptions const& options)
+{
+    m_threadc = options.threadc;
+    m_cache = options.cache;
+    m_cacheSalt = options.cache ? options.cacheSalt + "a11-function" : "";
+    m_optimize = options.optimize;
+    m_compact = options.compact;
+    m_layout = options.layout;
+    m_verify = options.verify;
+    m_indexed = options.indexed;
+
+    if(options.profile) m_superinstructions.select(*options.profile, SUPERINSTRUCTION_LIMIT);
+    else m_superinstructions.clear();
+}
+
+void TranslatorA11::singlePass()
+{
+    if(m_compact || m_layout || m_verify)
+    {
+        labelPass();
+        translationPass();
+        return;
+    }
+
+    m_singlePass = true;
+    m_context.isDeferring = true;
+    labelPass();
+    translationPass();
+}
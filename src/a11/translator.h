@@ -25,18 +25,41 @@
 #define TRANSLATOR_A11_H_
 
 #include <string>
-#include <ostream>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <algorithm>
 
 #include "../common.h"
+#include "../symbol_table.h"
 #include "../translator.h"
+#include "instructions.h"
+#include "layout.h"
+#include "optimizer.h"
+#include "superinstructions.h"
+#include "verifier.h"
+
+#define FIXUP_DECLARATION       0xFFFFFFFF
+
+#define ABY_SUPERINSTRUCTIONS   0x0001
+#define ABY_COMPACT             0x0002
+#define ABY_FRAMES              0x0004
+#define ABY_INDEXED             0x0008
+
+#define ABY_PAGE_SIZE           4096
+#define ABY_FUNCTION_ALIGNMENT  16
+
+inline u32 hashNameA11(std::string_view name)
+{
+    u32 hash = 2166136261u;
+    for(size_t i = 0; i < name.size(); i++)
+        hash = (hash ^ (u8) name[i]) * 16777619u;
+    return hash;
+}
 
 class TranslatorA11: public Translator
 {
 public:
-    TranslatorA11(Log* log, Scanner* scanner, std::ostream* out)
+    TranslatorA11(Log* log, Scanner* scanner, Emitter* out)
     : Translator(log, scanner, out),
       m_pc(0),
       m_filepos(0),
@@ -44,17 +67,81 @@ public:
       m_functionIDCounter(0),
       m_nativeIDCounter(0),
       m_gvarMPosCounter(0),
-      m_lvarMPosCounter(0) {}
+      m_lvarMPosCounter(0),
+      m_singlePass(false),
+      m_threadc(1),
+      m_cache(0),
+      m_optimize(false),
+      m_compact(false),
+      m_layout(false),
+      m_verify(false),
+      m_indexed(false),
+      m_verifier(log)
+    {
+        m_context.log = log;
+        m_context.scanner = scanner;
+        m_context.code = out;
+        m_context.isDeferring = false;
+        m_context.lvarMPosCounter = 0;
+        m_context.references = 0;
+    }
     ~TranslatorA11() {}
 
     void labelPass();
     void translationPass();
+
+    bool hasSinglePass() { return true; }
+    void singlePass();
+
+    bool reset(Log* log, Scanner* scanner, Emitter* out);
+
+    void setOptions(TranslatorOptions const& options);
+
+    static void readOperations(Log* log, Scanner* scanner, StringArena* operands, OperationsA11* operations);
+
+    static inline std::string_view nativeName(std::string_view token)
+    {
+        size_t signature = token.find('(');
+        return signature == std::string_view::npos ? token : token.substr(0, signature);
+    }
+
+    static bool parseNativeSignature(Log* log, std::string_view token, u32* argumentBytes, u32* resultBytes);
 private:
     struct FunctionData
     {
-        std::streampos inpos;
-        std::map<std::string, u32> labels;
+        u64 inpos;
+        u64 endpos;
         u32 size;
+        Emitter code;
+        OperationsA11 operations;
+    };
+
+    struct Fixup
+    {
+        u32 function;
+        u32 offset;
+        const InstructionA11* instruction;
+        std::string name;
+    };
+
+    struct LocalData
+    {
+        u32 mpos;
+        u32 function;
+    };
+
+    struct FunctionContext
+    {
+        Log* log;
+        Scanner* scanner;
+        Emitter* code;
+        bool isDeferring;
+        SymbolTable lvarMPos;
+        u32 lvarMPosCounter;
+        std::vector<Fixup> labelFixups;
+        std::vector<Fixup> symbolFixups;
+        std::vector<CacheReference>* references;
+        VariableLayoutA11 layout;
     };
 
     u32 m_pc;
@@ -65,16 +152,39 @@ private:
     u32 m_nativeIDCounter;
     u32 m_gvarMPosCounter;
     u32 m_lvarMPosCounter;
-    std::map<std::string, u32> m_functionIDs;
-    std::map<std::string, u32> m_nativeIDs;
-    std::map<std::string, u32> m_gvarMPos;
-    std::map<std::string, u32> m_lvarMPos;
+    SymbolTable m_functionIDs;
+    SymbolTable m_nativeIDs;
+    SymbolTable m_gvarMPos;
+    SymbolTable m_lvarIDs;
+    std::vector<LocalData> m_locals;
+    SymbolTable m_labels;
+    VariableLayoutA11 m_globals;
 
-    std::map<u32, FunctionData> m_functions;
+    std::vector<FunctionData> m_functions;
     std::vector<std::string> m_nativeFunctions;
 
-    inline void write(void* ptr, size_t size) { m_out->write(reinterpret_cast<const char*>(ptr), size); }
-    inline void writeByte(u8 byte) { m_out->write(reinterpret_cast<const char*>(&byte), 1); }
+    bool m_singlePass;
+    unsigned int m_threadc;
+    FunctionContext m_context;
+    AssemblyCache* m_cache;
+    std::string m_cacheSalt;
+
+    bool m_optimize;
+    bool m_compact;
+    bool m_layout;
+    bool m_verify;
+    bool m_indexed;
+    OptimizerA11 m_optimizer;
+    VerifierA11 m_verifier;
+    SuperinstructionsA11 m_superinstructions;
+    StringArena m_operands;
+
+    inline bool hasOperations() { return m_optimize || m_compact || m_layout || m_verify || !m_superinstructions.isEmpty(); }
+
+    static inline u64 zigzag(i64 value) { return ((u64) value << 1) ^ (u64) (value >> 63); }
+
+    inline void write(const void* ptr, size_t size) { m_out->write(ptr, size); }
+    inline void writeByte(u8 byte) { m_out->writeByte(byte); }
 
     inline u32 nextFunctionID()
     {
@@ -98,69 +208,153 @@ private:
         return m_gvarMPosCounter - size;
     }
 
-    inline u32 nextLVarMPos(u32 size)
+    inline u32 nextLVarMPos(FunctionContext* context, u32 size)
     {
-        u32 old = m_lvarMPosCounter;
-        m_lvarMPosCounter += size;
-        if(m_lvarMPosCounter < old) m_log->abort("localvar ID overflow");
-        return m_lvarMPosCounter - size;
+        u32 old = context->lvarMPosCounter;
+        context->lvarMPosCounter += size;
+        if(context->lvarMPosCounter < old) context->log->abort("localvar ID overflow");
+        return context->lvarMPosCounter - size;
     }
 
-    inline u32 functionIDFor(std::string name, bool create)
+    inline u32 functionIDFor(std::string_view name, bool create)
     {
-        if(m_functionIDs.find(name) == m_functionIDs.end())
-        {
-            if(create) m_functionIDs[name] = nextFunctionID();
-            else m_log->abort("function \"" + name + "\" not found");
-        }
+        u32* value = m_functionIDs.find(name);
+        if(value) return *value;
 
-        return m_functionIDs[name];
+        if(!create) m_log->abort("function \"" + std::string(name) + "\" not found");
+        u32 id = nextFunctionID();
+        m_functionIDs.set(name, id);
+        return id;
     }
 
-    inline u32 nativeIDFor(std::string name, bool create)
+    inline u32 nativeIDFor(std::string_view name, bool create)
     {
-        if(m_nativeIDs.find(name) == m_nativeIDs.end())
-        {
-            if(create) m_nativeIDs[name] = nextNativeID();
-            else m_log->abort("native \"" + name + "\" not found");
-        }
+        u32* value = m_nativeIDs.find(name);
+        if(value) return *value;
 
-        return m_nativeIDs[name];
+        if(!create) m_log->abort("native \"" + std::string(name) + "\" not found");
+        u32 id = nextNativeID();
+        m_nativeIDs.set(name, id);
+        return id;
     }
 
-    inline u32 gvarMPosFor(std::string name, bool create, u32 size)
+    inline u32 gvarMPosFor(std::string_view name, bool create, u32 size)
     {
-        if(m_gvarMPos.find(name) == m_gvarMPos.end())
-        {
-            if(create) m_gvarMPos[name] = nextGVarMPos(size);
-            else m_log->abort("globalvar \"" + name + "\" not found");
-        }
-        return m_gvarMPos[name];
+        u32* value = m_gvarMPos.find(name);
+        if(value) return *value;
+
+        if(!create) m_log->abort("globalvar \"" + std::string(name) + "\" not found");
+        u32 mpos = nextGVarMPos(size);
+        m_gvarMPos.set(name, mpos);
+        return mpos;
+    }
+
+    inline u32 lvarMPosFor(FunctionContext* context, std::string_view name, bool create, u32 size)
+    {
+        u32* value = context->lvarMPos.find(name);
+        if(value) return *value;
+
+        if(!create) context->log->abort("var \"" + std::string(name) + "\" not found");
+        u32 mpos = nextLVarMPos(context, size);
+        context->lvarMPos.set(name, mpos);
+        return mpos;
     }
 
-    inline u32 lvarMPosFor(std::string name, bool create, u32 size)
+    inline void declareLocal(u32 id, std::string_view name, u32 size)
     {
-        if(m_lvarMPos.find(name) == m_lvarMPos.end())
+        if(m_lvarIDs.find(name)) return;
+        u32 old = m_lvarMPosCounter;
+        m_lvarMPosCounter += size;
+        if(m_lvarMPosCounter < old) m_log->abort("localvar ID overflow");
+
+        LocalData local;
+        local.mpos = old;
+        local.function = id;
+        m_lvarIDs.set(name, m_locals.size());
+        m_locals.push_back(local);
+    }
+
+    inline bool findLocal(u32 id, FunctionContext* context, std::string_view name, bool isDefinition, u32* mpos)
+    {
+        u32* index = m_lvarIDs.find(name);
+        if(!index) return false;
+        const LocalData& local = m_locals[*index];
+        if(local.function > id) return false;
+        if(local.function == id)
         {
-            if(create) m_lvarMPos[name] = nextLVarMPos(size);
-            else m_log->abort("var \"" + name + "\" not found");
+            if(isDefinition) context->lvarMPos.set(name, local.mpos);
+            else if(!context->lvarMPos.find(name)) return false;
         }
-        return m_lvarMPos[name];
+        *mpos = local.mpos;
+        return true;
+    }
+
+    inline u32 localMPosFor(u32 id, FunctionContext* context, std::string_view name, bool isDefinition)
+    {
+        u32 mpos = 0;
+        if(!findLocal(id, context, name, isDefinition, &mpos))
+            context->log->abort("var \"" + std::string(name) + "\" not found");
+        addReference(context, isDefinition ? OPERAND_LVAR_DEF : OPERAND_LVAR, 0, name, mpos);
+        return mpos;
     }
 
     void passFunction(u32 id);
+    void readFunction(u32 id);
+    void prepareFunction(u32 id);
+    void layoutFunction(u32 id);
+    void layoutLocals(u32 id, FunctionContext* context);
+    void layoutGlobals();
+    void verifyFunctions();
+    u32 getFrameSize(u32 id);
+    void writeOperations(u32 id, FunctionContext* context);
+
+    void resolveFunction(u32 id);
+    void relaxFunction(u32 id);
+    void writeCompactOperations(u32 id, FunctionContext* context);
     u32 getFunctionSize(u32 id);
-    u32 getLabelPC(u32 id, std::string labelName);
-    void writeFunction(u32 id);
+    u32 getLabelPC(u32 id, std::string_view labelName);
+    void writeFunction(u32 id, FunctionContext* context);
+    void writeOperand(u32 id, FunctionContext* context, const InstructionA11* instruction, std::string_view operand);
+    void declareOperand(u32 id, FunctionContext* context, const InstructionA11* instruction, std::string_view operand);
+
+    inline void addReference(FunctionContext* context, const InstructionA11* instruction, std::string_view name, u32 value)
+    {
+        addReference(context, instruction->operand, instruction->varSize, name, value);
+    }
+
+    inline void addReference(FunctionContext* context, u8 kind, u8 size, std::string_view name, u32 value)
+    {
+        if(!context->references) return;
+        CacheReference reference;
+        reference.kind = kind;
+        reference.size = size;
+        reference.value = value;
+        reference.name = name;
+        context->references->push_back(reference);
+    }
+
+    void writeFunctionCached(u32 id);
+    bool matchReferences(u32 id, const std::vector<CacheReference>& references);
+
+    void encodeFunction(u32 id, FunctionContext* context);
+    void encodeFunctionsParallel();
+    void deferOperand(std::vector<Fixup>* fixups, u32 id, FunctionContext* context, const InstructionA11* instruction, std::string_view operand);
+    u32 resolveSymbol(u8 operand, u32 varSize, std::string_view name);
+    u32 resolveOperand(const Fixup& fixup);
+    void patchFixups(std::vector<Fixup>* fixups);
 
     void function();
     void native();
     void globalvar();
 
+    u32 getOutputSize();
+
     void writeHeader();
     void writeNativeData();
     void writeFunctions();
+    void writeFunctionCode(u32 id, bool isEncoded);
     void writeGlobalvarData();
+    void writeIndex(size_t base);
 };
 
 #endif /* TRANSLATOR_A11_H_ */
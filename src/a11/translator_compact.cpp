@@ -0,0 +1,152 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: translator_compact.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "translator.h"
+
+void TranslatorA11::resolveFunction(u32 id)
+{
+    FunctionContext* context = &m_context;
+    context->lvarMPos.clear();
+    context->lvarMPosCounter = 0;
+    if(m_layout) layoutLocals(id, context);
+
+    OperationsA11& operations = m_functions[id].operations;
+    for(OperationsA11::iterator i = operations.begin(); i != operations.end(); i++)
+    {
+        if(i->isLabel()) continue;
+
+        const InstructionA11* instruction = i->instruction;
+        OperandA11 operand = instruction->operand;
+        if(i->isDeclaration)
+        {
+            if(operand == OPERAND_LVAR_DEF) lvarMPosFor(context, i->operand, true, instruction->varSize);
+            else gvarMPosFor(i->operand, true, instruction->varSize);
+            continue;
+        }
+
+        switch(operand)
+        {
+        case OPERAND_NONE: i->width = 0; break;
+        case OPERAND_INT4:
+        case OPERAND_FLOAT4: i->width = Emitter::varintSize(zigzag((i32) i->immediate)); break;
+        case OPERAND_INT8:
+        {
+            if(!i->isImmediate)
+            {
+                i->immediate = lvarMPosFor(context, i->operand.substr(1), false, 0);
+                i->isImmediate = true;
+            }
+            i->width = Emitter::varintSize(zigzag((i64) i->immediate));
+            break;
+        }
+        case OPERAND_FLOAT8: i->width = Emitter::varintSize(zigzag((i64) i->immediate)); break;
+        case OPERAND_LABEL: i->width = 1; break;
+        default:
+        {
+            u32 value = 0;
+            switch(operand)
+            {
+            case OPERAND_LVAR:
+            case OPERAND_LVAR_DEF: value = lvarMPosFor(context, i->operand, operand == OPERAND_LVAR_DEF, instruction->varSize); break;
+            case OPERAND_GVAR:
+            case OPERAND_GVAR_DEF: value = gvarMPosFor(i->operand, operand == OPERAND_GVAR_DEF, instruction->varSize); break;
+            case OPERAND_FUNCTION: value = functionIDFor(i->operand, false); break;
+            case OPERAND_NATIVE: value = nativeIDFor(i->operand, false); break;
+            default: break;
+            }
+            i->immediate = value;
+            i->isImmediate = true;
+            i->width = Emitter::varintSize(value);
+            break;
+        }
+        }
+    }
+}
+
+void TranslatorA11::relaxFunction(u32 id)
+{
+    FunctionData& function = m_functions[id];
+    OperationsA11& operations = function.operations;
+
+    bool isChanged = true;
+    while(isChanged)
+    {
+        u32 pc = 0;
+        for(OperationsA11::iterator i = operations.begin(); i != operations.end(); i++)
+        {
+            if(i->isLabel()) m_labels.set(i->operand, pc, id);
+            else if(i->isInstruction()) pc += (i->isFused ? 0 : 1) + i->width;
+        }
+        function.size = pc;
+
+        isChanged = false;
+        pc = 0;
+        for(OperationsA11::iterator i = operations.begin(); i != operations.end(); i++)
+        {
+            if(!i->isInstruction()) continue;
+            if(!i->isFused) pc++;
+            if(i->instruction->operand == OPERAND_LABEL)
+            {
+                i64 displacement = (i64) getLabelPC(id, i->operand) - pc;
+                u8 width = Emitter::varintSize(zigzag(displacement));
+                if(width > i->width)
+                {
+                    i->width = width;
+                    isChanged = true;
+                }
+            }
+            pc += i->width;
+        }
+    }
+}
+
+void TranslatorA11::writeCompactOperations(u32 id, FunctionContext* context)
+{
+    Emitter* code = context->code;
+    size_t begin = code->size();
+
+    const OperationsA11& operations = m_functions.at(id).operations;
+    for(OperationsA11::const_iterator i = operations.begin(); i != operations.end(); i++)
+    {
+        if(!i->isInstruction()) continue;
+
+        const InstructionA11* instruction = i->instruction;
+        if(!i->isFused) code->writeByte(i->superOpcode ? i->superOpcode : instruction->opcode);
+
+        switch(instruction->operand)
+        {
+        case OPERAND_NONE: break;
+        case OPERAND_INT4:
+        case OPERAND_FLOAT4: code->writeVarint(zigzag((i32) i->immediate), i->width); break;
+        case OPERAND_INT8:
+        case OPERAND_FLOAT8: code->writeVarint(zigzag((i64) i->immediate), i->width); break;
+        case OPERAND_LABEL:
+        {
+            i64 displacement = (i64) getLabelPC(id, i->operand) - (i64) (code->size() - begin);
+            code->writeVarint(zigzag(displacement), i->width);
+            break;
+        }
+        default: code->writeVarint(i->immediate, i->width); break;
+        }
+    }
+}
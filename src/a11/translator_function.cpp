@@ -22,171 +22,216 @@
  */
 
 #include "translator.h"
+#include "instructions.h"
 
-#define OP_NOP          0x00
-#define OP_PUSH4        0x08
-#define OP_PUSH8        0x09
-#define OP_POP4         0x0C
-#define OP_POP8         0x0D
-
-#define OP_LOAD4        0x10
-#define OP_LOAD8        0x11
-#define OP_LOADWIDE4    0x12
-#define OP_LOADWIDE8    0x13
-#define OP_FETCH4       0x18
-#define OP_FETCH8       0x19
-#define OP_FETCHWIDE4   0x1A
-#define OP_FETCHWIDE8   0x1B
-#define OP_VARPTR       0x1C
-#define OP_VARPTRWIDE   0x1D
-
-#define OP_ALLOC        0x20
-#define OP_FREE         0x21
-
-#define OP_REFL1        0x30
-#define OP_REFL2        0x31
-#define OP_REFL4        0x32
-#define OP_REFL8        0x33
-#define OP_EXTR1        0x38
-#define OP_EXTR2        0x39
-#define OP_EXTR4        0x3A
-#define OP_EXTR8        0x3B
-
-#define OP_SWAP4        0x40
-#define OP_SWAP8        0x41
-#define OP_SWAP48       0x42
-#define OP_SWAP84       0x43
-#define OP_DUP4         0x48
-#define OP_DUP8         0x49
-
-#define OP_ADDI4        0x50
-#define OP_ADDI8        0x51
-#define OP_ADDF4        0x52
-#define OP_ADDF8        0x53
-#define OP_SUBI4        0x54
-#define OP_SUBI8        0x55
-#define OP_SUBF4        0x56
-#define OP_SUBF8        0x57
-#define OP_MULI4        0x58
-#define OP_MULI8        0x59
-#define OP_MULF4        0x5A
-#define OP_MULF8        0x5B
-#define OP_DIVI4        0x5C
-#define OP_DIVI8        0x5D
-#define OP_DIVU4        0x5E
-#define OP_DIVU8        0x5F
-#define OP_DIVF4        0x60
-#define OP_DIVF8        0x61
-#define OP_REMI4        0x62
-#define OP_REMI8        0x63
-#define OP_REMU4        0x64
-#define OP_REMU8        0x65
-#define OP_NEGI4        0x66
-#define OP_NEGI8        0x67
-#define OP_NEGF4        0x68
-#define OP_NEGF8        0x69
-
-#define OP_SHL4         0x80
-#define OP_SHL8         0x81
-#define OP_SHR4         0x82
-#define OP_SHR8         0x83
-#define OP_SHRU4        0x84
-#define OP_SHRU8        0x85
-#define OP_BNOT4        0x86
-#define OP_BNOT8        0x87
-#define OP_BAND4        0x88
-#define OP_BAND8        0x89
-#define OP_BXOR4        0x8A
-#define OP_BXOR8        0x8B
-#define OP_BOR4         0x8C
-#define OP_BOR8         0x8D
-
-#define OP_LNOT4        0xA0
-#define OP_LNOT8        0xA1
-#define OP_LAND4        0xA2
-#define OP_LAND8        0xA3
-#define OP_LOR4         0xA4
-#define OP_LOR8         0xA5
-
-#define OP_CI14         0xB0
-#define OP_CI24         0xB1
-#define OP_CI41         0xB2
-#define OP_CI42         0xB3
-#define OP_CI48         0xB4
-#define OP_CI84         0xB5
-#define OP_CF48         0xB6
-#define OP_CF84         0xB7
-#define OP_CFI4         0xB8
-#define OP_CFI8         0xB9
-#define OP_CIF4         0xBA
-#define OP_CIF8         0xBB
-
-#define OP_GOTO         0xD0
-#define OP_CALL         0xD1
-#define OP_RETURN       0xD2
-#define OP_NATIVE       0xD3
-#define OP_IF           0xD4
-#define OP_IFN          0xD5
-#define OP_LTNL         0xDA
-#define OP_LENL         0xDB
-#define OP_GTNL         0xDC
-#define OP_GENL         0xDD
-#define OP_EQNL         0xDE
-#define OP_NENL         0xDF
-
-#define OP_CMP4         0xE0
-#define OP_CMP8         0xE1
-#define OP_ICMP4        0xE2
-#define OP_ICMP8        0xE3
-#define OP_IUCMP4       0xE4
-#define OP_IUCMP8       0xE5
-#define OP_IUCMPR4      0xE6
-#define OP_IUCMPR8      0xE7
-#define OP_FCMP4        0xE8
-#define OP_FCMP8        0xE9
-#define OP_FICMP4       0xEA
-#define OP_FICMP8       0xEB
-#define OP_FICMPR4      0xEC
-#define OP_FICMPR8      0xED
-#define OP_FUCMP4       0xEE
-#define OP_FUCMP8       0xEF
-#define OP_FUCMPR4      0xF1
-#define OP_FUCMPR8      0xF2
+#include <sstream>
+
+#include "../thread_pool.h"
 
 void TranslatorA11::passFunction(u32 id)
 {
     m_pc = 0;
-    m_functions[id].inpos = m_scanner->getIn()->tellg();
-    m_functions[id].labels.clear();
+    FunctionData& function = m_functions[id];
+    function.inpos = m_scanner->getPosition();
+
+    if(hasOperations())
+    {
+        prepareFunction(id);
+        function.endpos = m_scanner->getPosition();
+        return;
+    }
 
     while(true)
     {
         m_scanner->nextTokenEOF();
-        std::string token = m_scanner->getToken();
+        std::string_view token = m_scanner->token();
 
         if(token == ".") break;
 
         if(token[token.size() - 1] == ':')
         {
-            m_functions[id].labels[token.substr(0, token.size() - 1)] = m_pc;
+            m_labels.set(token.substr(0, token.size() - 1), m_pc, id);
             continue;
         }
 
-        m_pc++;
-        if(token == "load4" || token == "load8" || token == "fetch4" || token == "fetch8"
-        || token == "loadwide4" || token == "loadwide8" || token == "fetchwide4" || token == "fetchwide8"
-        || token == "if" || token == "ifn" || token == "goto" || token == "call" || token == "native"
-        || token == "pushi4" || token == "pushi8"|| token == "pushf4" || token == "pushf8"
-        || token == "varptr" || token == "varptrwide")
-        {
-            m_pc += 4;
-            if(token == "pushi8" || token == "pushf8") m_pc += 4;
+        const InstructionA11* instruction = findInstructionA11(token.data(), token.size());
+        if(!instruction)
+            m_log->abort("unrecognized mnemonic \"" + std::string(token) + "\"");
 
+        m_pc += 1 + instruction->width;
+        if(instruction->operand != OPERAND_NONE)
             m_scanner->nextTokenEOF();
+        if(instruction->operand == OPERAND_LVAR_DEF)
+            declareLocal(id, m_scanner->token(), instruction->varSize);
+    }
+
+    function.endpos = m_scanner->getPosition();
+    function.size = m_pc;
+}
+
+void TranslatorA11::readOperations(Log* log, Scanner* scanner, StringArena* operands, OperationsA11* operations)
+{
+    operations->clear();
+
+    while(true)
+    {
+        scanner->nextTokenEOF();
+        std::string_view token = scanner->token();
+        if(token == ".") break;
+
+        OperationA11 operation;
+
+        if(token[token.size() - 1] == ':')
+        {
+            token = token.substr(0, token.size() - 1);
+            operation.operand = scanner->hasBuffer() ? token : operands->store(token);
+            operations->push_back(operation);
+            continue;
+        }
+
+        operation.instruction = findInstructionA11(token.data(), token.size());
+        if(!operation.instruction)
+            log->abort("unrecognized mnemonic \"" + std::string(token) + "\"");
+
+        if(operation.instruction->operand != OPERAND_NONE)
+        {
+            scanner->nextTokenEOF();
+            std::string_view operand = scanner->token();
+            switch(operation.instruction->operand)
+            {
+            case OPERAND_INT4:
+            {
+                i32 value = parseInteger(operand);
+                std::memcpy(&operation.immediate, &value, 4);
+                operation.isImmediate = true;
+                break;
+            }
+            case OPERAND_INT8:
+            {
+                if(operand[0] == '@') break;
+                i64 value = parseInteger(operand);
+                std::memcpy(&operation.immediate, &value, 8);
+                operation.isImmediate = true;
+                break;
+            }
+            case OPERAND_FLOAT4:
+            {
+                f32 value = parseFloat(operand);
+                std::memcpy(&operation.immediate, &value, 4);
+                operation.isImmediate = true;
+                break;
+            }
+            case OPERAND_FLOAT8:
+            {
+                f64 value = parseFloat(operand);
+                std::memcpy(&operation.immediate, &value, 8);
+                operation.isImmediate = true;
+                break;
+            }
+            default: break;
+            }
+            if(!operation.isImmediate)
+                operation.operand = scanner->hasBuffer() ? operand : operands->store(operand);
         }
+
+        operations->push_back(operation);
     }
+}
 
-    m_functions[id].size = m_pc;
+void TranslatorA11::readFunction(u32 id)
+{
+    readOperations(m_log, m_scanner, &m_operands, &m_functions[id].operations);
+}
+
+void TranslatorA11::prepareFunction(u32 id)
+{
+    OperationsA11& operations = m_functions[id].operations;
+    readFunction(id);
+    if(m_optimize) m_optimizer.optimize(&operations);
+    if(!m_superinstructions.isEmpty()) m_superinstructions.apply(&operations);
+    if(!m_compact) layoutFunction(id);
+}
+
+void TranslatorA11::layoutLocals(u32 id, FunctionContext* context)
+{
+    VariableLayoutA11& layout = context->layout;
+    layout.clear();
+
+    const OperationsA11& operations = m_functions.at(id).operations;
+    for(OperationsA11::const_iterator i = operations.begin(); i != operations.end(); i++)
+    {
+        if(i->isLabel()) continue;
+        switch(i->instruction->operand)
+        {
+        case OPERAND_LVAR_DEF:
+            layout.declare(i->operand, i->instruction->varSize);
+            if(!i->isDeclaration) layout.access(i->operand);
+            break;
+        case OPERAND_LVAR: layout.access(i->operand); break;
+        case OPERAND_INT8: if(!i->isImmediate) layout.access(i->operand.substr(1)); break;
+        default: break;
+        }
+    }
+    context->lvarMPosCounter = layout.assign(&context->lvarMPos);
+}
+
+void TranslatorA11::layoutGlobals()
+{
+    for(u32 id = 0; id < m_functionIDCounter; id++)
+    {
+        const OperationsA11& operations = m_functions[id].operations;
+        for(OperationsA11::const_iterator i = operations.begin(); i != operations.end(); i++)
+        {
+            if(i->isLabel()) continue;
+            switch(i->instruction->operand)
+            {
+            case OPERAND_GVAR_DEF:
+                m_globals.declare(i->operand, i->instruction->varSize);
+                if(!i->isDeclaration) m_globals.access(i->operand);
+                break;
+            case OPERAND_GVAR: m_globals.access(i->operand); break;
+            default: break;
+            }
+        }
+    }
+    m_gvarMPosCounter = m_globals.assign(&m_gvarMPos);
+}
+
+void TranslatorA11::verifyFunctions()
+{
+    for(u32 id = 0; id < m_functionIDCounter; id++)
+        m_verifier.addFunction(m_functionIDs.getName(id), &m_functions[id].operations);
+    m_verifier.verify();
+}
+
+u32 TranslatorA11::getFrameSize(u32 id)
+{
+    FunctionContext context;
+    context.log = m_log;
+    context.lvarMPosCounter = 0;
+    if(m_layout)
+    {
+        layoutLocals(id, &context);
+        return context.lvarMPosCounter;
+    }
+
+    const OperationsA11& operations = m_functions[id].operations;
+    for(OperationsA11::const_iterator i = operations.begin(); i != operations.end(); i++)
+        if(!i->isLabel() && i->instruction->operand == OPERAND_LVAR_DEF)
+            lvarMPosFor(&context, i->operand, true, i->instruction->varSize);
+    return context.lvarMPosCounter;
+}
+
+void TranslatorA11::layoutFunction(u32 id)
+{
+    FunctionData& function = m_functions[id];
+    u32 pc = 0;
+    for(OperationsA11::iterator i = function.operations.begin(); i != function.operations.end(); i++)
+    {
+        if(i->isLabel()) m_labels.set(i->operand, pc, id);
+        else if(i->isInstruction()) pc += (i->isFused ? 0 : 1) + i->instruction->width;
+    }
+    function.size = pc;
 }
 
 u32 TranslatorA11::getFunctionSize(u32 id)
@@ -194,281 +239,400 @@ u32 TranslatorA11::getFunctionSize(u32 id)
     return m_functions[id].size;
 }
 
-u32 TranslatorA11::getLabelPC(u32 id, std::string labelName)
+u32 TranslatorA11::getLabelPC(u32 id, std::string_view labelName)
 {
-    FunctionData fdat = m_functions[id];
-    if(fdat.labels.find(labelName) == fdat.labels.end())
-        m_log->abort("label \"" + labelName + "\" not found");
-    return fdat.labels[labelName];
+    u32* pc = m_labels.find(labelName, id);
+    if(!pc)
+        m_log->abort("label \"" + std::string(labelName) + "\" not found");
+    return *pc;
 }
 #include <iostream>
 
-void TranslatorA11::writeFunction(u32 id)
+void TranslatorA11::writeFunction(u32 id, FunctionContext* context)
 {
-    m_scanner->getIn()->seekg(m_functions[id].inpos);
+    context->lvarMPos.clear();
+    context->lvarMPosCounter = 0;
+
+    if(hasOperations())
+    {
+        writeOperations(id, context);
+        return;
+    }
+
+    Scanner* scanner = context->scanner;
+    scanner->setPosition(m_functions.at(id).inpos);
+
     while(true)
     {
-        m_scanner->nextTokenEOF();
-        std::string token = m_scanner->getToken();
+        scanner->nextTokenEOF();
+        std::string_view token = scanner->token();
         if(token == ".") break;
         if(token[token.size() - 1] == ':') continue;
 
-        if(token == "nop") { writeByte(OP_NOP); continue; }
-        if(token == "pushi4")
-        {
-            writeByte(OP_PUSH4);
-            m_scanner->nextTokenEOF();
-            i32 value = std::atoi(m_scanner->getToken().c_str());
-            write(&value, 4);
-            continue;
-        }
-        if(token == "pushi8")
-        {
-            writeByte(OP_PUSH8);
-            m_scanner->nextTokenEOF();
-            i64 value;
-            if(m_scanner->getToken()[0] == '@') value = lvarMPosFor(m_scanner->getToken().substr(1), false, 0);
-            else value = std::atoll(m_scanner->getToken().c_str());
-            write(&value, 8);
-            continue;
-        }
-        if(token == "pushf4")
-        {
-            writeByte(OP_PUSH4);
-            m_scanner->nextTokenEOF();
-            f32 value = std::atof(m_scanner->getToken().c_str());
-            write(&value, 4);
-            continue;
-        }
-        if(token == "pushf8")
-        {
-            writeByte(OP_PUSH8);
-            m_scanner->nextTokenEOF();
-            f64 value = std::atof(m_scanner->getToken().c_str());
-            write(&value, 8);
-            continue;
-        }
-        if(token == "pop4") { writeByte(OP_POP4); continue; }
-        if(token == "pop8") { writeByte(OP_POP8); continue; }
-        if(token == "load4")
-        {
-            writeByte(OP_LOAD4);
-            m_scanner->nextTokenEOF();
-            u32 mpos = lvarMPosFor(m_scanner->getToken(), true, 4);
-            write(&mpos, 4);
-            continue;
-        }
-        if(token == "load8")
-        {
-            writeByte(OP_LOAD8);
-            m_scanner->nextTokenEOF();
-            u32 mpos = lvarMPosFor(m_scanner->getToken(), true, 8);
-            write(&mpos, 4);
-            continue;
-        }
-        if(token == "fetch4")
-        {
-            writeByte(OP_FETCH4);
-            m_scanner->nextTokenEOF();
-            u32 mpos = lvarMPosFor(m_scanner->getToken(), false, 4);
-            write(&mpos, 4);
-            continue;
-        }
-        if(token == "fetch8")
-        {
-            writeByte(OP_FETCH8);
-            m_scanner->nextTokenEOF();
-            u32 mpos = lvarMPosFor(m_scanner->getToken(), false, 8);
-            write(&mpos, 4);
-            continue;
-        }
-        if(token == "loadwide4")
-        {
-            writeByte(OP_LOADWIDE4);
-            m_scanner->nextTokenEOF();
-            u32 mpos = gvarMPosFor(m_scanner->getToken(), true, 4);
-            write(&mpos, 4);
-            continue;
-        }
-        if(token == "loadwide8")
-        {
-            writeByte(OP_LOADWIDE8);
-            m_scanner->nextTokenEOF();
-            u32 mpos = gvarMPosFor(m_scanner->getToken(), true, 8);
-            write(&mpos, 4);
-            continue;
-        }
-        if(token == "fetchwide4")
+        const InstructionA11* instruction = findInstructionA11(token.data(), token.size());
+        if(!instruction)
+            context->log->abort("unrecognized mnemonic \"" + std::string(token) + "\"");
+
+        context->code->writeByte(instruction->opcode);
+        if(instruction->operand == OPERAND_NONE) continue;
+
+        scanner->nextTokenEOF();
+        writeOperand(id, context, instruction, scanner->token());
+    }
+}
+
+void TranslatorA11::writeOperations(u32 id, FunctionContext* context)
+{
+    if(m_compact)
+    {
+        writeCompactOperations(id, context);
+        return;
+    }
+    if(m_layout) layoutLocals(id, context);
+
+    const OperationsA11& operations = m_functions.at(id).operations;
+    for(OperationsA11::const_iterator i = operations.begin(); i != operations.end(); i++)
+    {
+        if(i->isLabel()) continue;
+        if(i->isDeclaration)
         {
-            writeByte(OP_FETCHWIDE4);
-            m_scanner->nextTokenEOF();
-            u32 mpos = gvarMPosFor(m_scanner->getToken(), false, 4);
-            write(&mpos, 4);
+            declareOperand(id, context, i->instruction, i->operand);
             continue;
         }
-        if(token == "fetchwide8")
+
+        const InstructionA11* instruction = i->instruction;
+        if(!i->isFused) context->code->writeByte(i->superOpcode ? i->superOpcode : instruction->opcode);
+        if(instruction->operand == OPERAND_NONE) continue;
+
+        if(i->isImmediate) context->code->write(&i->immediate, instruction->width);
+        else writeOperand(id, context, instruction, i->operand);
+    }
+}
+
+void TranslatorA11::declareOperand(u32 id, FunctionContext* context, const InstructionA11* instruction, std::string_view operand)
+{
+    if(instruction->operand == OPERAND_LVAR_DEF)
+    {
+        lvarMPosFor(context, operand, true, instruction->varSize);
+        return;
+    }
+
+    if(context->isDeferring && !m_gvarMPos.find(operand))
+    {
+        Fixup fixup;
+        fixup.function = id;
+        fixup.offset = FIXUP_DECLARATION;
+        fixup.instruction = instruction;
+        fixup.name = operand;
+        context->symbolFixups.push_back(fixup);
+        return;
+    }
+    u32 mpos = gvarMPosFor(operand, true, instruction->varSize);
+    addReference(context, instruction, operand, mpos);
+}
+
+void TranslatorA11::writeOperand(u32 id, FunctionContext* context, const InstructionA11* instruction, std::string_view operand)
+{
+    Emitter* code = context->code;
+    switch(instruction->operand)
+    {
+    case OPERAND_INT4:
+    {
+        i32 value = parseInteger(operand);
+        code->write(&value, 4);
+        break;
+    }
+    case OPERAND_INT8:
+    {
+        i64 value;
+        if(operand[0] != '@') value = parseInteger(operand);
+        else if(hasOperations()) value = lvarMPosFor(context, operand.substr(1), false, 0);
+        else value = localMPosFor(id, context, operand.substr(1), false);
+        code->write(&value, 8);
+        break;
+    }
+    case OPERAND_FLOAT4:
+    {
+        f32 value = parseFloat(operand);
+        code->write(&value, 4);
+        break;
+    }
+    case OPERAND_FLOAT8:
+    {
+        f64 value = parseFloat(operand);
+        code->write(&value, 8);
+        break;
+    }
+    case OPERAND_LVAR:
+    case OPERAND_LVAR_DEF:
+    {
+        bool isDefinition = instruction->operand == OPERAND_LVAR_DEF;
+        u32 mpos;
+        if(hasOperations()) mpos = lvarMPosFor(context, operand, isDefinition, instruction->varSize);
+        else
         {
-            writeByte(OP_FETCHWIDE8);
-            m_scanner->nextTokenEOF();
-            u32 mpos = gvarMPosFor(m_scanner->getToken(), false, 8);
-            write(&mpos, 4);
-            continue;
+            if(m_singlePass && isDefinition) declareLocal(id, operand, instruction->varSize);
+            mpos = localMPosFor(id, context, operand, isDefinition);
         }
-        if(token == "varptr")
+        code->write(&mpos, 4);
+        break;
+    }
+    case OPERAND_GVAR:
+    case OPERAND_GVAR_DEF:
+    {
+        if(context->isDeferring && !m_gvarMPos.find(operand))
         {
-            writeByte(OP_VARPTR);
-            m_scanner->nextTokenEOF();
-            u32 mpos = lvarMPosFor(m_scanner->getToken(), false, 4);
-            write(&mpos, 4);
-            continue;
+            deferOperand(&context->symbolFixups, id, context, instruction, operand);
+            break;
         }
-        if(token == "varptrwide")
+        u32 mpos = gvarMPosFor(operand, instruction->operand == OPERAND_GVAR_DEF, instruction->varSize);
+        addReference(context, instruction, operand, mpos);
+        code->write(&mpos, 4);
+        break;
+    }
+    case OPERAND_LABEL:
+    {
+        if(m_singlePass)
         {
-            writeByte(OP_VARPTRWIDE);
-            m_scanner->nextTokenEOF();
-            u32 mpos = gvarMPosFor(m_scanner->getToken(), false, 4);
-            write(&mpos, 4);
-            continue;
+            deferOperand(&context->labelFixups, id, context, instruction, operand);
+            break;
         }
-        if(token == "alloc") { writeByte(OP_ALLOC); continue; }
-        if(token == "free") { writeByte(OP_FREE); continue; }
-        if(token == "refl1") { writeByte(OP_REFL1); continue; }
-        if(token == "refl2") { writeByte(OP_REFL2); continue; }
-        if(token == "refl4") { writeByte(OP_REFL4); continue; }
-        if(token == "refl8") { writeByte(OP_REFL8); continue; }
-        if(token == "extr1") { writeByte(OP_EXTR1); continue; }
-        if(token == "extr2") { writeByte(OP_EXTR2); continue; }
-        if(token == "extr4") { writeByte(OP_EXTR4); continue; }
-        if(token == "extr8") { writeByte(OP_EXTR8); continue; }
-        if(token == "swap4") { writeByte(OP_SWAP4); continue; }
-        if(token == "swap8") { writeByte(OP_SWAP8); continue; }
-        if(token == "swap48") { writeByte(OP_SWAP48); continue; }
-        if(token == "swap84") { writeByte(OP_SWAP84); continue; }
-        if(token == "dup4") { writeByte(OP_DUP4); continue; }
-        if(token == "dup8") { writeByte(OP_DUP8); continue; }
-        if(token == "addi4") { writeByte(OP_ADDI4); continue; }
-        if(token == "addi8") { writeByte(OP_ADDI8); continue; }
-        if(token == "addf4") { writeByte(OP_ADDF4); continue; }
-        if(token == "addf8") { writeByte(OP_ADDF8); continue; }
-        if(token == "subi4") { writeByte(OP_SUBI4); continue; }
-        if(token == "subi8") { writeByte(OP_SUBI8); continue; }
-        if(token == "subf4") { writeByte(OP_SUBF4); continue; }
-        if(token == "subf8") { writeByte(OP_SUBF8); continue; }
-        if(token == "muli4") { writeByte(OP_MULI4); continue; }
-        if(token == "muli8") { writeByte(OP_MULI8); continue; }
-        if(token == "mulf4") { writeByte(OP_MULF4); continue; }
-        if(token == "mulf8") { writeByte(OP_MULF8); continue; }
-        if(token == "divi4") { writeByte(OP_DIVI4); continue; }
-        if(token == "divi8") { writeByte(OP_DIVI8); continue; }
-        if(token == "divu4") { writeByte(OP_DIVU4); continue; }
-        if(token == "divu8") { writeByte(OP_DIVU8); continue; }
-        if(token == "divf4") { writeByte(OP_DIVF4); continue; }
-        if(token == "divf8") { writeByte(OP_DIVF8); continue; }
-        if(token == "remi4") { writeByte(OP_REMI4); continue; }
-        if(token == "remi8") { writeByte(OP_REMI8); continue; }
-        if(token == "remu4") { writeByte(OP_REMU4); continue; }
-        if(token == "remu8") { writeByte(OP_REMU8); continue; }
-        if(token == "negi4") { writeByte(OP_NEGI4); continue; }
-        if(token == "negi8") { writeByte(OP_NEGI8); continue; }
-        if(token == "negf4") { writeByte(OP_NEGF4); continue; }
-        if(token == "negf8") { writeByte(OP_NEGF8); continue; }
-        if(token == "shl4") { writeByte(OP_SHL4); continue; }
-        if(token == "shl8") { writeByte(OP_SHL8); continue; }
-        if(token == "shr4") { writeByte(OP_SHR4); continue; }
-        if(token == "shr8") { writeByte(OP_SHR8); continue; }
-        if(token == "shru4") { writeByte(OP_SHRU4); continue; }
-        if(token == "shru8") { writeByte(OP_SHRU8); continue; }
-        if(token == "bnot4") { writeByte(OP_BNOT4); continue; }
-        if(token == "bnot8") { writeByte(OP_BNOT8); continue; }
-        if(token == "band4") { writeByte(OP_BAND4); continue; }
-        if(token == "band8") { writeByte(OP_BAND8); continue; }
-        if(token == "bxor4") { writeByte(OP_BXOR4); continue; }
-        if(token == "bxor8") { writeByte(OP_BXOR8); continue; }
-        if(token == "bor4") { writeByte(OP_BOR4); continue; }
-        if(token == "bor8") { writeByte(OP_BOR8); continue; }
-        if(token == "lnot4") { writeByte(OP_LNOT4); continue; }
-        if(token == "lnot8") { writeByte(OP_LNOT8); continue; }
-        if(token == "land4") { writeByte(OP_LAND4); continue; }
-        if(token == "land8") { writeByte(OP_LAND8); continue; }
-        if(token == "lor4") { writeByte(OP_LOR4); continue; }
-        if(token == "lor8") { writeByte(OP_LOR8); continue; }
-        if(token == "ci14") { writeByte(OP_CI14); continue; }
-        if(token == "ci24") { writeByte(OP_CI24); continue; }
-        if(token == "ci41") { writeByte(OP_CI41); continue; }
-        if(token == "ci42") { writeByte(OP_CI42); continue; }
-        if(token == "ci48") { writeByte(OP_CI48); continue; }
-        if(token == "ci84") { writeByte(OP_CI84); continue; }
-        if(token == "cf48") { writeByte(OP_CF48); continue; }
-        if(token == "cf84") { writeByte(OP_CF84); continue; }
-        if(token == "cfi4") { writeByte(OP_CFI4); continue; }
-        if(token == "cfi8") { writeByte(OP_CFI8); continue; }
-        if(token == "cif4") { writeByte(OP_CIF4); continue; }
-        if(token == "cif8") { writeByte(OP_CIF8); continue; }
-        if(token == "goto")
+        u32* pc = m_labels.find(operand, id);
+        if(!pc)
+            context->log->abort("label \"" + std::string(operand) + "\" not found");
+        code->write(pc, 4);
+        break;
+    }
+    case OPERAND_FUNCTION:
+    {
+        if(context->isDeferring && !m_functionIDs.find(operand))
         {
-            writeByte(OP_GOTO);
-            m_scanner->nextTokenEOF();
-            u32 pos = getLabelPC(id, m_scanner->getToken());
-            write(&pos, 4);
-            continue;
+            deferOperand(&context->symbolFixups, id, context, instruction, operand);
+            break;
         }
-        if(token == "if")
+        u32 function = functionIDFor(operand, false);
+        addReference(context, instruction, operand, function);
+        code->write(&function, 4);
+        break;
+    }
+    case OPERAND_NATIVE:
+    {
+        if(context->isDeferring && !m_nativeIDs.find(operand))
         {
-            writeByte(OP_IF);
-            m_scanner->nextTokenEOF();
-            u32 pos = getLabelPC(id, m_scanner->getToken());
-            write(&pos, 4);
-            continue;
+            deferOperand(&context->symbolFixups, id, context, instruction, operand);
+            break;
         }
-        if(token == "ifn")
+        u32 native = nativeIDFor(operand, false);
+        addReference(context, instruction, operand, native);
+        code->write(&native, 4);
+        break;
+    }
+    default: break;
+    }
+}
+
+void TranslatorA11::writeFunctionCached(u32 id)
+{
+    FunctionData& function = m_functions[id];
+    const char* source = m_scanner->getBufferBegin() + function.inpos;
+    CacheKey key = AssemblyCache::hash(m_cacheSalt, source, function.endpos - function.inpos);
+
+    CacheEntry entry;
+    if(m_cache->load(key, &entry) && entry.code.size() == function.size && matchReferences(id, entry.references))
+    {
+        m_cache->countHit(AssemblyCache::FUNCTION);
+        write(entry.code.data(), entry.code.size());
+        return;
+    }
+    m_cache->countMiss(AssemblyCache::FUNCTION);
+
+    std::vector<CacheReference> references;
+    size_t begin = m_out->size();
+    m_context.references = &references;
+    writeFunction(id, &m_context);
+    m_context.references = 0;
+    m_cache->store(key, m_out->data() + begin, m_out->size() - begin, references);
+}
+
+bool TranslatorA11::matchReferences(u32 id, const std::vector<CacheReference>& references)
+{
+    m_context.lvarMPos.clear();
+    bool isMatching = true;
+    for(std::vector<CacheReference>::const_iterator i = references.begin(); i != references.end(); i++)
+    {
+        if(i->kind == OPERAND_LVAR || i->kind == OPERAND_LVAR_DEF)
         {
-            writeByte(OP_IFN);
-            m_scanner->nextTokenEOF();
-            u32 pos = getLabelPC(id, m_scanner->getToken());
-            write(&pos, 4);
-            continue;
+            u32 mpos;
+            if(!findLocal(id, &m_context, i->name, i->kind == OPERAND_LVAR_DEF, &mpos) || mpos != i->value)
+                isMatching = false;
         }
-        if(token == "ltnl") { writeByte(OP_LTNL); continue; }
-        if(token == "lenl") { writeByte(OP_LENL); continue; }
-        if(token == "gtnl") { writeByte(OP_GTNL); continue; }
-        if(token == "genl") { writeByte(OP_GENL); continue; }
-        if(token == "eqnl") { writeByte(OP_EQNL); continue; }
-        if(token == "nenl") { writeByte(OP_NENL); continue; }
-        if(token == "cmp4") { writeByte(OP_CMP4); continue; }
-        if(token == "cmp8") { writeByte(OP_CMP8); continue; }
-        if(token == "icmp4") { writeByte(OP_ICMP4); continue; }
-        if(token == "icmp8") { writeByte(OP_ICMP8); continue; }
-        if(token == "iucmp4") { writeByte(OP_IUCMP4); continue; }
-        if(token == "iucmp8") { writeByte(OP_IUCMP8); continue; }
-        if(token == "iucmpr4") { writeByte(OP_IUCMPR4); continue; }
-        if(token == "iucmpr8") { writeByte(OP_IUCMPR8); continue; }
-        if(token == "fcmp4") { writeByte(OP_FCMP4); continue; }
-        if(token == "fcmp8") { writeByte(OP_FCMP8); continue; }
-        if(token == "ficmp4") { writeByte(OP_FICMP4); continue; }
-        if(token == "ficmp8") { writeByte(OP_FICMP8); continue; }
-        if(token == "ficmpr4") { writeByte(OP_FICMPR4); continue; }
-        if(token == "ficmpr8") { writeByte(OP_FICMPR8); continue; }
-        if(token == "fucmp4") { writeByte(OP_FUCMP4); continue; }
-        if(token == "fucmp8") { writeByte(OP_FUCMP8); continue; }
-        if(token == "fucmpr4") { writeByte(OP_FUCMPR4); continue; }
-        if(token == "fucmpr8") { writeByte(OP_FUCMPR8); continue; }
-        if(token == "call")
+        else if(resolveSymbol(i->kind, i->size, i->name) != i->value)
+            isMatching = false;
+    }
+    return isMatching;
+}
+
+void TranslatorA11::encodeFunction(u32 id, FunctionContext* context)
+{
+    Scanner* scanner = context->scanner;
+    FunctionData& function = m_functions[id];
+    function.code.clear();
+
+    Emitter* out = context->code;
+    context->code = &function.code;
+    context->lvarMPos.clear();
+    context->lvarMPosCounter = 0;
+
+    if(hasOperations())
+    {
+        prepareFunction(id);
+        writeOperations(id, context);
+    }
+    else
+    {
+        while(true)
         {
-            writeByte(OP_CALL);
-            m_scanner->nextTokenEOF();
-            u32 id = functionIDFor(m_scanner->getToken(), false);
-            write(&id, 4);
-            continue;
+            scanner->nextTokenEOF();
+            std::string_view token = scanner->token();
+
+            if(token == ".") break;
+
+            if(token[token.size() - 1] == ':')
+            {
+                m_labels.set(token.substr(0, token.size() - 1), function.code.size(), id);
+                continue;
+            }
+
+            const InstructionA11* instruction = findInstructionA11(token.data(), token.size());
+            if(!instruction)
+                context->log->abort("unrecognized mnemonic \"" + std::string(token) + "\"");
+
+            function.code.writeByte(instruction->opcode);
+            if(instruction->operand == OPERAND_NONE) continue;
+
+            scanner->nextTokenEOF();
+            writeOperand(id, context, instruction, scanner->token());
         }
-        if(token == "return") { writeByte(OP_RETURN); continue; }
-        if(token == "native")
+    }
+
+    context->code = out;
+    function.size = function.code.size();
+    patchFixups(&context->labelFixups);
+}
+
+struct EncoderChunk
+{
+    u32 begin;
+    u32 end;
+    std::ostringstream out;
+    Log log;
+    bool isFailed;
+    std::string failure;
+
+    EncoderChunk(): begin(0), end(0), isFailed(false) {}
+};
+
+void TranslatorA11::encodeFunctionsParallel()
+{
+    u32 functionc = m_functionIDCounter;
+    u32 chunkc = std::min<u32>(functionc, m_threadc * 8);
+    if(chunkc == 0) return;
+
+    std::vector<EncoderChunk> chunks(chunkc);
+    std::vector<FunctionContext> contexts(chunkc);
+    ThreadPool pool(m_threadc);
+
+    for(u32 chunki = 0; chunki < chunkc; chunki++)
+    {
+        EncoderChunk& chunk = chunks[chunki];
+        chunk.begin = (u64) functionc * chunki / chunkc;
+        chunk.end = (u64) functionc * (chunki + 1) / chunkc;
+        chunk.log.setStream(&chunk.out, Log::INFO);
+        chunk.log.setStream(&chunk.out, Log::WARNING);
+        chunk.log.setStream(&chunk.out, Log::ERROR);
+        chunk.log.setMuted(true, Log::ERROR);
+        chunk.log.setAbortThrows(true);
+
+        pool.submit([this, &chunk, &contexts, chunki]
         {
-            writeByte(OP_NATIVE);
-            m_scanner->nextTokenEOF();
-            u32 id = nativeIDFor(m_scanner->getToken(), false);
-            write(&id, 4);
-            continue;
-        }
-        m_log->abort("unrecognized mnemonic \"" + token + "\"");
+            Scanner scanner(&chunk.log, m_scanner->getBufferBegin(), m_scanner->getBufferEnd());
+
+            FunctionContext& context = contexts[chunki];
+            context.log = &chunk.log;
+            context.scanner = &scanner;
+            context.isDeferring = true;
+            context.lvarMPosCounter = 0;
+
+            try
+            {
+                for(u32 i = chunk.begin; i < chunk.end; i++)
+                {
+                    FunctionData& function = m_functions.at(i);
+                    function.code.clear();
+                    function.code.reserve(function.size);
+                    context.code = &function.code;
+                    writeFunction(i, &context);
+                }
+            }
+            catch(LogAbort& abort)
+            {
+                chunk.isFailed = true;
+                chunk.failure = abort.message;
+            }
+        });
+    }
+    pool.wait();
+
+    for(u32 chunki = 0; chunki < chunkc; chunki++)
+    {
+        EncoderChunk& chunk = chunks[chunki];
+        m_log->log(chunk.out.str(), Log::WARNING);
+        if(chunk.isFailed) m_log->abort(chunk.failure);
+        patchFixups(&contexts[chunki].symbolFixups);
+    }
+}
+
+void TranslatorA11::deferOperand(std::vector<Fixup>* fixups, u32 id, FunctionContext* context, const InstructionA11* instruction, std::string_view operand)
+{
+    Fixup fixup;
+    fixup.function = id;
+    fixup.offset = context->code->size();
+    fixup.instruction = instruction;
+    fixup.name = operand;
+    fixups->push_back(fixup);
+
+    u32 placeholder = 0;
+    context->code->write(&placeholder, 4);
+}
+
+u32 TranslatorA11::resolveSymbol(u8 operand, u32 varSize, std::string_view name)
+{
+    switch(operand)
+    {
+    case OPERAND_GVAR: return gvarMPosFor(name, false, varSize);
+    case OPERAND_GVAR_DEF: return gvarMPosFor(name, true, varSize);
+    case OPERAND_FUNCTION: return functionIDFor(name, false);
+    case OPERAND_NATIVE: return nativeIDFor(name, false);
+    default: m_log->abort("invalid symbol reference \"" + std::string(name) + "\"");
+    }
+    return 0;
+}
+
+u32 TranslatorA11::resolveOperand(const Fixup& fixup)
+{
+    const InstructionA11* instruction = fixup.instruction;
+    if(instruction->operand == OPERAND_LABEL)
+        return getLabelPC(fixup.function, fixup.name);
+    return resolveSymbol(instruction->operand, instruction->varSize, fixup.name);
+}
+
+void TranslatorA11::patchFixups(std::vector<Fixup>* fixups)
+{
+    for(std::vector<Fixup>::iterator i = fixups->begin(); i != fixups->end(); i++)
+    {
+        u32 value = resolveOperand(*i);
+        if(i->offset != FIXUP_DECLARATION)
+            m_functions[i->function].code.patch(i->offset, &value, 4);
     }
+    fixups->clear();
 }
@@ -0,0 +1,291 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: verifier.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "verifier.h"
+
+#include <algorithm>
+
+void VerifierA11::addFunction(std::string_view name, const OperationsA11* operations)
+{
+    u32 id = m_functions.size();
+    m_functionIDs.set(name, id);
+
+    FunctionData function;
+    function.name = name;
+    function.operations = operations;
+    function.frame.hasEffect = false;
+    function.frame.effect = 0;
+    function.frame.low = 0;
+    function.frame.high = 0;
+    m_functions.push_back(function);
+
+    for(u32 i = 0; i < operations->size(); i++)
+        if((*operations)[i].isLabel()) m_labelIndices.set((*operations)[i].operand, i, id);
+}
+
+void VerifierA11::addNative(std::string_view name, bool hasSignature, u32 argumentBytes, u32 resultBytes)
+{
+    m_nativeIDs.set(name, m_natives.size());
+
+    NativeData native;
+    native.name = name;
+    native.hasSignature = hasSignature;
+    native.argumentBytes = argumentBytes;
+    native.resultBytes = resultBytes;
+    m_natives.push_back(native);
+}
+
+void VerifierA11::clear()
+{
+    m_functions.clear();
+    m_natives.clear();
+    m_functionIDs.clear();
+    m_nativeIDs.clear();
+    m_labelIndices.clear();
+}
+
+bool VerifierA11::getShape(u8 opcode, ShapeA11* shape)
+{
+    if(getShapeA11(opcode, shape)) return true;
+    switch(opcode)
+    {
+    case OP_ICMP4: case OP_FICMP4: case OP_FICMPR4: case OP_FUCMP4: case OP_FUCMPR4:
+        *shape = { 2, 4, 4 }; return true;
+    case OP_ICMP8: case OP_FICMP8: case OP_FICMPR8: case OP_FUCMP8: case OP_FUCMPR8:
+        *shape = { 2, 8, 4 }; return true;
+    default: return false;
+    }
+}
+
+void VerifierA11::fail(const std::string& message)
+{
+    const OperationA11& operation = (*m_function->operations)[m_index];
+    std::string where = operation.isLabel() ? "label \"" + std::string(operation.operand) + "\""
+                                            : "\"" + std::string(operation.instruction->mnemonic) + "\"";
+    m_log->abort(message + " at " + where + " in function \"" + m_function->name + "\"");
+}
+
+void VerifierA11::pop(State* state, u32 width)
+{
+    u8 top = state->slots.empty() ? (u8) SLOT_ANY : state->slots.back();
+    if(width == 4)
+    {
+        if(top != SLOT_ANY && top != SLOT_4) fail("4-byte operand taken from an 8-byte value");
+    }
+    else
+    {
+        u8 below = state->slots.size() < 2 ? (u8) SLOT_ANY : state->slots[state->slots.size() - 2];
+        if((top != SLOT_ANY && top != SLOT_8_HIGH) || (below != SLOT_ANY && below != SLOT_8_LOW))
+            fail("8-byte operand taken from 4-byte values");
+    }
+    popBytes(state, width);
+}
+
+void VerifierA11::popBytes(State* state, u32 bytes)
+{
+    state->slots.resize(state->slots.size() - std::min<size_t>(state->slots.size(), bytes / 4));
+    state->height -= bytes;
+    if(!state->slots.empty() && state->slots.back() == SLOT_8_LOW) fail("8-byte value split");
+    m_low = std::min(m_low, state->height);
+}
+
+void VerifierA11::push(State* state, u32 width)
+{
+    if(width == 4) state->slots.push_back(SLOT_4);
+    else
+    {
+        state->slots.push_back(SLOT_8_LOW);
+        state->slots.push_back(SLOT_8_HIGH);
+    }
+    state->height += width;
+    m_high = std::max(m_high, state->height);
+}
+
+void VerifierA11::pushBytes(State* state, u32 bytes)
+{
+    state->slots.insert(state->slots.end(), bytes / 4, SLOT_ANY);
+    state->height += bytes;
+    m_high = std::max(m_high, state->height);
+}
+
+bool VerifierA11::merge(State* into, const State& state)
+{
+    if(into->height == HEIGHT_UNKNOWN)
+    {
+        *into = state;
+        return true;
+    }
+    if(into->height != state.height) fail("inconsistent stack height");
+
+    size_t count = std::min(into->slots.size(), state.slots.size());
+    std::vector<u8> slots(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        u8 a = into->slots[into->slots.size() - count + i];
+        u8 b = state.slots[state.slots.size() - count + i];
+        if(a != b && a != SLOT_ANY && b != SLOT_ANY) fail("inconsistent stack types");
+        slots[i] = a == b ? a : (u8) SLOT_ANY;
+    }
+    if(slots == into->slots) return false;
+    into->slots.swap(slots);
+    return true;
+}
+
+bool VerifierA11::step(const OperationA11& operation, State* state)
+{
+    u8 opcode = operation.instruction->opcode;
+    ShapeA11 shape;
+    if(getShape(opcode, &shape))
+    {
+        for(u32 i = 0; i < shape.operandc; i++) pop(state, shape.operandWidth);
+        push(state, shape.resultWidth);
+        return true;
+    }
+
+    switch(opcode)
+    {
+    case OP_PUSH4: case OP_FETCH4: case OP_FETCHWIDE4: push(state, 4); break;
+    case OP_PUSH8: case OP_FETCH8: case OP_FETCHWIDE8: case OP_VARPTR: case OP_VARPTRWIDE: push(state, 8); break;
+    case OP_POP4: case OP_LOAD4: case OP_LOADWIDE4: case OP_IF: case OP_IFN: pop(state, 4); break;
+    case OP_POP8: case OP_LOAD8: case OP_LOADWIDE8: case OP_FREE: pop(state, 8); break;
+    case OP_ALLOC: case OP_REFL8: pop(state, 8); push(state, 8); break;
+    case OP_REFL1: case OP_REFL2: case OP_REFL4: pop(state, 8); push(state, 4); break;
+    case OP_EXTR1: case OP_EXTR2: case OP_EXTR4: pop(state, 4); pop(state, 8); break;
+    case OP_EXTR8: pop(state, 8); pop(state, 8); break;
+    case OP_SWAP4: pop(state, 4); pop(state, 4); push(state, 4); push(state, 4); break;
+    case OP_SWAP8: pop(state, 8); pop(state, 8); push(state, 8); push(state, 8); break;
+    case OP_SWAP48: pop(state, 8); pop(state, 4); push(state, 8); push(state, 4); break;
+    case OP_SWAP84: pop(state, 4); pop(state, 8); push(state, 4); push(state, 8); break;
+    case OP_DUP4: pop(state, 4); push(state, 4); push(state, 4); break;
+    case OP_DUP8: pop(state, 8); push(state, 8); push(state, 8); break;
+    case OP_CALL:
+    {
+        u32* id = m_functionIDs.find(operation.operand);
+        if(!id) fail("function \"" + std::string(operation.operand) + "\" not found");
+        const FrameA11& callee = m_functions[*id].frame;
+        if(!callee.hasEffect) return false;
+        popBytes(state, -callee.low);
+        pushBytes(state, callee.effect - callee.low);
+        break;
+    }
+    case OP_NATIVE:
+    {
+        u32* id = m_nativeIDs.find(operation.operand);
+        if(!id) fail("native \"" + std::string(operation.operand) + "\" not found");
+        const NativeData& native = m_natives[*id];
+        if(!native.hasSignature)
+            fail("native \"" + native.name + "\" has no stack signature, e.g. \"" + native.name + "(8,4)\",");
+        popBytes(state, native.argumentBytes);
+        pushBytes(state, native.resultBytes);
+        break;
+    }
+    default: break;
+    }
+    return true;
+}
+
+bool VerifierA11::verifyFunction(u32 id)
+{
+    FunctionData& function = m_functions[id];
+    const OperationsA11& operations = *function.operations;
+    m_function = &function;
+    m_index = 0;
+    m_low = 0;
+    m_high = 0;
+
+    State unknown;
+    unknown.height = HEIGHT_UNKNOWN;
+    function.states.assign(operations.size(), unknown);
+
+    bool hasEffect = false;
+    i32 effect = 0;
+    std::vector<u32> worklist;
+    auto reach = [&](u32 index, const State& state)
+    {
+        if(index == operations.size())
+        {
+            if(hasEffect && effect != state.height) fail("inconsistent stack height on return");
+            hasEffect = true;
+            effect = state.height;
+        }
+        else
+        {
+            u32 current = m_index;
+            m_index = index;
+            if(merge(&function.states[index], state)) worklist.push_back(index);
+            m_index = current;
+        }
+    };
+
+    State entry;
+    entry.height = 0;
+    reach(0, entry);
+    while(!worklist.empty())
+    {
+        m_index = worklist.back();
+        worklist.pop_back();
+        State state = function.states[m_index];
+        const OperationA11& operation = operations[m_index];
+
+        if(!operation.isInstruction()) reach(m_index + 1, state);
+        else if(operation.is(OP_RETURN)) reach(operations.size(), state);
+        else if(step(operation, &state))
+        {
+            if(m_low < -VERIFIER_STACK_LIMIT || m_high > VERIFIER_STACK_LIMIT) fail("operand stack too deep");
+            if(operation.isJump())
+            {
+                u32* target = m_labelIndices.find(operation.operand, id);
+                if(!target) fail("label \"" + std::string(operation.operand) + "\" not found");
+                reach(*target, state);
+            }
+            if(!operation.is(OP_GOTO)) reach(m_index + 1, state);
+        }
+    }
+
+    FrameA11 frame;
+    frame.hasEffect = hasEffect;
+    frame.effect = effect;
+    frame.low = m_low;
+    frame.high = std::max(m_high, effect);
+    bool isChanged = frame.hasEffect != function.frame.hasEffect || frame.effect != function.frame.effect
+                  || frame.low != function.frame.low || frame.high != function.frame.high;
+    function.frame = frame;
+    return isChanged;
+}
+
+void VerifierA11::verify()
+{
+    bool isChanged = true;
+    while(isChanged)
+    {
+        isChanged = false;
+        for(u32 id = 0; id < m_functions.size(); id++)
+            if(verifyFunction(id)) isChanged = true;
+    }
+
+    // Callers account for the stack their callees consume, but nothing calls
+    // the entry function, so it must not reach below its own empty stack.
+    u32* main = m_functionIDs.find("main");
+    if(main && m_functions[*main].frame.low < 0)
+        m_log->abort("operand stack underflow in entry function \"main\"");
+}
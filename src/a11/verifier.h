@@ -0,0 +1,119 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: verifier.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef VERIFIER_A11_H_
+#define VERIFIER_A11_H_
+
+#include <climits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../common.h"
+#include "../log.h"
+#include "../symbol_table.h"
+#include "optimizer.h"
+#include "semantics.h"
+
+#define HEIGHT_UNKNOWN          INT_MIN
+#define VERIFIER_STACK_LIMIT    0x40000
+
+struct FrameA11
+{
+    bool hasEffect;
+    i32 effect;
+    i32 low;
+    i32 high;
+};
+
+class VerifierA11
+{
+public:
+    VerifierA11(Log* log): m_log(log) {}
+
+    void addFunction(std::string_view name, const OperationsA11* operations);
+    void addNative(std::string_view name, bool hasSignature, u32 argumentBytes, u32 resultBytes);
+    void verify();
+    void clear();
+
+    inline void setLog(Log* log) { m_log = log; }
+
+    inline const FrameA11& getFrame(u32 id) const { return m_functions[id].frame; }
+    inline i32 getHeight(u32 id, u32 index) const { return m_functions[id].states[index].height; }
+
+    static bool getShape(u8 opcode, ShapeA11* shape);
+private:
+    enum Slot
+    {
+        SLOT_ANY,
+        SLOT_4,
+        SLOT_8_LOW,
+        SLOT_8_HIGH
+    };
+
+    struct State
+    {
+        i32 height;
+        std::vector<u8> slots;
+    };
+
+    struct FunctionData
+    {
+        std::string name;
+        const OperationsA11* operations;
+        std::vector<State> states;
+        FrameA11 frame;
+    };
+
+    struct NativeData
+    {
+        std::string name;
+        bool hasSignature;
+        u32 argumentBytes;
+        u32 resultBytes;
+    };
+
+    Log* m_log;
+    std::vector<FunctionData> m_functions;
+    std::vector<NativeData> m_natives;
+    SymbolTable m_functionIDs;
+    SymbolTable m_nativeIDs;
+    SymbolTable m_labelIndices;
+
+    const FunctionData* m_function;
+    u32 m_index;
+    i32 m_low;
+    i32 m_high;
+
+    void fail(const std::string& message);
+    void pop(State* state, u32 width);
+    void popBytes(State* state, u32 bytes);
+    void push(State* state, u32 width);
+    void pushBytes(State* state, u32 bytes);
+    bool merge(State* into, const State& state);
+
+    bool step(const OperationA11& operation, State* state);
+    bool verifyFunction(u32 id);
+};
+
+#endif /* VERIFIER_A11_H_ */
@@ -0,0 +1,59 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: instructions.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef INSTRUCTIONS_A11R_H_
+#define INSTRUCTIONS_A11R_H_
+
+#include "../a11/instructions.h"
+
+/*
+ * A11R reuses the A11 opcodes, but every operand that lived on the stack is
+ * now an explicit u16 register (a 4-byte cell in the frame; 8-byte values
+ * take two adjacent cells):
+ *
+ *   binary ALU           op dst a b
+ *   unary ALU, refl      op dst a
+ *   mov4, mov8           op dst src
+ *   push4, push8         op dst imm4/imm8
+ *   fetchwide            op dst gpos4
+ *   loadwide             op gpos4 src
+ *   varptr               op dst reg
+ *   varptrwide           op dst gpos4
+ *   alloc                op dst size
+ *   free                 op ptr
+ *   extr                 op ptr value
+ *   goto                 op pc4
+ *   if, ifn              op cond pc4
+ *   call, native         op id4 base
+ *   return               op
+ *
+ * Arguments of call and native are the cells starting at base, and the
+ * results are written back starting at the same cell.
+ */
+
+#define ROP_MOV4        0x01
+#define ROP_MOV8        0x02
+
+#define ABY_REGISTERS   28
+
+#endif /* INSTRUCTIONS_A11R_H_ */
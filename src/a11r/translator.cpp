@@ -0,0 +1,174 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: translator.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "translator.h"
+
+#include <algorithm>
+
+#include "../a11/translator.h"
+
+void TranslatorA11R::function()
+{
+    if(m_scanner->token().size() > 2)
+        m_log->abort("invalid function def \"" + m_scanner->getToken() + "\"");
+
+    m_scanner->nextTokenEOF();
+    std::string_view name = m_scanner->token();
+
+    if(m_functionIDs.find(name))
+        m_log->abort("function \"" + std::string(name) + "\" redeclared");
+    u32 id = m_functionIDCounter++;
+    if(m_functionIDCounter == 0) m_log->abort("function ID overflow");
+    m_functionIDs.set(name, id);
+    if(name == "main") m_main = id;
+
+    m_functions.resize(m_functionIDCounter);
+    FunctionData& function = m_functions[id];
+    function.name = name;
+    function.frameCells = 0;
+
+    TranslatorA11::readOperations(m_log, m_scanner, &m_operands, &function.operations);
+    if(m_optimize) m_optimizer.optimize(&function.operations);
+}
+
+void TranslatorA11R::native()
+{
+    if(m_scanner->token().size() > 2)
+        m_log->abort("invalid native def \"" + m_scanner->getToken() + "\"");
+
+    m_scanner->nextTokenEOF();
+    std::string_view token = m_scanner->token();
+    std::string_view name = TranslatorA11::nativeName(token);
+
+    if(m_nativeIDs.find(name))
+        m_log->abort("native \"" + std::string(name) + "\" redeclared");
+    m_nativeIDs.set(name, m_nativeIDCounter++);
+    if(m_nativeIDCounter == 0) m_log->abort("native ID overflow");
+
+    NativeData native;
+    native.name = name;
+    native.hasSignature = TranslatorA11::parseNativeSignature(m_log, token, &native.argumentBytes, &native.resultBytes);
+    m_natives.push_back(native);
+    m_verifier.addNative(name, native.hasSignature, native.argumentBytes, native.resultBytes);
+}
+
+void TranslatorA11R::globalvar()
+{
+    m_scanner->nextTokenEOF();
+    std::string_view amltype = m_scanner->token();
+    u32 size = 0;
+    if(amltype == "i4") size = 4;
+    else if(amltype == "i8") size = 8;
+    else if(amltype == "f4") size = 4;
+    else if(amltype == "f8") size = 8;
+    else m_log->abort("invalid AML type " + std::string(amltype));
+    m_scanner->nextTokenEOF();
+    gvarMPosFor(m_scanner->token(), true, size);
+}
+
+void TranslatorA11R::writeHeader()
+{
+    writeByte('A');
+    writeByte('B');
+    writeByte('Y');
+    writeByte(ABY_REGISTERS);
+
+    u16 version = 0;
+    write(&version, 2);
+}
+
+void TranslatorA11R::writeNativeData()
+{
+    u32 nativecount = m_nativeIDCounter;
+    write(&nativecount, 4);
+
+    for(u32 i = 0; i < nativecount; i++)
+    {
+        const NativeData& native = m_natives[i];
+        u16 argumentBytes = native.hasSignature ? native.argumentBytes : 0xFFFF;
+        u16 resultBytes = native.hasSignature ? native.resultBytes : 0xFFFF;
+        write(native.name.data(), native.name.size());
+        writeByte(0x00);
+        write(&argumentBytes, 2);
+        write(&resultBytes, 2);
+    }
+}
+
+void TranslatorA11R::writeFunctions()
+{
+    u32 functionc = m_functionIDCounter;
+    write(&functionc, 4);
+
+    for(u32 i = 0; i < functionc; i++)
+    {
+        FunctionData& function = m_functions[i];
+        const FrameA11& frame = m_verifier.getFrame(i);
+        u32 size = function.code.size();
+        u16 paramCells = -frame.low / 4;
+        u16 resultCells = frame.hasEffect ? (frame.effect - frame.low) / 4 : 0;
+        write(&size, 4);
+        write(&function.frameCells, 2);
+        write(&paramCells, 2);
+        write(&resultCells, 2);
+        write(function.code.data(), size);
+    }
+
+    write(&m_main, 4);
+}
+
+void TranslatorA11R::writeGlobalvarData()
+{
+    write(&m_gvarMPosCounter, 4);
+}
+
+void TranslatorA11R::labelPass()
+{
+    while(m_scanner->advance())
+    {
+        std::string_view token = m_scanner->token();
+        if(token.length() < 2 || token[1] != ':')
+            m_log->abort("invalid block def \"" + std::string(token) + "\"");
+
+        switch(token[0])
+        {
+        case 'f': function(); break;
+        case 'n': native(); break;
+        case 'w': globalvar(); break;
+        }
+    }
+
+    for(u32 i = 0; i < m_functionIDCounter; i++)
+        m_verifier.addFunction(m_functions[i].name, &m_functions[i].operations);
+    m_verifier.verify();
+}
+
+void TranslatorA11R::translationPass()
+{
+    for(u32 i = 0; i < m_functionIDCounter; i++)
+        translateFunction(i);
+
+    writeHeader();
+    writeNativeData();
+    writeFunctions();
+    writeGlobalvarData();
+}
@@ -0,0 +1,228 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: translator.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef TRANSLATOR_A11R_H_
+#define TRANSLATOR_A11R_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../common.h"
+#include "../symbol_table.h"
+#include "../translator.h"
+#include "../a11/optimizer.h"
+#include "../a11/verifier.h"
+#include "instructions.h"
+
+#define REGISTER_LIMIT          0x10000
+#define REGISTER_SCRATCH        16
+
+class TranslatorA11R: public Translator
+{
+public:
+    TranslatorA11R(Log* log, Scanner* scanner, Emitter* out)
+    : Translator(log, scanner, out),
+      m_main(0),
+      m_functionIDCounter(0),
+      m_nativeIDCounter(0),
+      m_gvarMPosCounter(0),
+      m_optimize(false),
+      m_verifier(log),
+      m_function(0),
+      m_frame(0),
+      m_height(0),
+      m_localBase(0),
+      m_localCells(0),
+      m_lastDefinition(NO_DEFINITION),
+      m_isReachable(false) {}
+    ~TranslatorA11R() {}
+
+    void labelPass();
+    void translationPass();
+
+    void setOptions(TranslatorOptions const& options) { m_optimize = options.optimize; }
+private:
+    static const u32 NO_DEFINITION = 0xFFFFFFFF;
+
+    struct NativeData
+    {
+        std::string name;
+        bool hasSignature;
+        u32 argumentBytes;
+        u32 resultBytes;
+    };
+
+    struct FunctionData
+    {
+        std::string name;
+        OperationsA11 operations;
+        Emitter code;
+        u16 frameCells;
+    };
+
+    enum ValueKind
+    {
+        VALUE_OWN,
+        VALUE_CELL,
+        VALUE_CONSTANT
+    };
+
+    struct Value
+    {
+        ValueKind kind;
+        u8 width;
+        i32 height;
+        u32 cell;
+        u64 constant;
+        u32 definition;
+    };
+
+    struct Fixup
+    {
+        u32 offset;
+        std::string_view label;
+    };
+
+    u32 m_main;
+
+    u32 m_functionIDCounter;
+    u32 m_nativeIDCounter;
+    u32 m_gvarMPosCounter;
+    SymbolTable m_functionIDs;
+    SymbolTable m_nativeIDs;
+    SymbolTable m_gvarMPos;
+
+    std::vector<FunctionData> m_functions;
+    std::vector<NativeData> m_natives;
+
+    bool m_optimize;
+    OptimizerA11 m_optimizer;
+    VerifierA11 m_verifier;
+    StringArena m_operands;
+
+    FunctionData* m_function;
+    const FrameA11* m_frame;
+    std::vector<Value> m_stack;
+    i32 m_height;
+    u32 m_localBase;
+    u32 m_localCells;
+    u32 m_lastDefinition;
+    bool m_isReachable;
+    SymbolTable m_locals;
+    SymbolTable m_labelPCs;
+    std::vector<Fixup> m_fixups;
+
+    inline void write(const void* ptr, size_t size) { m_out->write(ptr, size); }
+    inline void writeByte(u8 byte) { m_out->writeByte(byte); }
+
+    inline u32 nextGVarMPos(u32 size)
+    {
+        u32 old = m_gvarMPosCounter;
+        m_gvarMPosCounter += size;
+        if(m_gvarMPosCounter < old) m_log->abort("globalvar ID overflow");
+        return m_gvarMPosCounter - size;
+    }
+
+    inline u32 functionIDFor(std::string_view name)
+    {
+        u32* value = m_functionIDs.find(name);
+        if(!value) m_log->abort("function \"" + std::string(name) + "\" not found");
+        return *value;
+    }
+
+    inline u32 nativeIDFor(std::string_view name)
+    {
+        u32* value = m_nativeIDs.find(name);
+        if(!value) m_log->abort("native \"" + std::string(name) + "\" not found");
+        return *value;
+    }
+
+    inline u32 gvarMPosFor(std::string_view name, bool create, u32 size)
+    {
+        u32* value = m_gvarMPos.find(name);
+        if(value) return *value;
+
+        if(!create) m_log->abort("globalvar \"" + std::string(name) + "\" not found");
+        u32 mpos = nextGVarMPos(size);
+        m_gvarMPos.set(name, mpos);
+        return mpos;
+    }
+
+    inline u32 localCellFor(std::string_view name, bool create, u32 size)
+    {
+        u32* value = m_locals.find(name);
+        if(value) return *value;
+
+        if(!create) m_log->abort("var \"" + std::string(name) + "\" not found");
+        u32 cell = m_localBase + m_localCells;
+        m_localCells += size / 4;
+        m_locals.set(name, cell);
+        return cell;
+    }
+
+    inline u32 cellAt(i32 height) { return (height - m_frame->low) / 4; }
+
+    void function();
+    void native();
+    void globalvar();
+
+    void translateFunction(u32 id);
+    void translateOperation(const OperationA11& operation);
+
+    static inline Value own(u8 width, u32 definition)
+    {
+        Value value;
+        value.kind = VALUE_OWN;
+        value.width = width;
+        value.height = 0;
+        value.cell = 0;
+        value.constant = 0;
+        value.definition = definition;
+        return value;
+    }
+
+    void reset(i32 height);
+    void push(Value value);
+    Value pop(u32 width);
+    void materialize(Value* value);
+    void materializeAll();
+    bool materializeAliases(u32 cell, u32 cells);
+    u32 registerFor(Value* value);
+    void define(u8 width, u32 definition);
+    void swap(u8 topWidth, u8 bottomWidth);
+    void invoke(u8 opcode, u32 id, i32 argumentBytes, i32 resultBytes);
+
+    void emitOpcode(u8 opcode);
+    u32 emitRegister(u32 cell);
+    void emitLabel(std::string_view label);
+    void emitMove(u8 width, u32 dst, u32 src);
+    void emitConstant(u8 width, u32 dst, u64 constant);
+
+    void writeHeader();
+    void writeNativeData();
+    void writeFunctions();
+    void writeGlobalvarData();
+};
+
+#endif /* TRANSLATOR_A11R_H_ */
@@ -0,0 +1,463 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: translator_function.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "translator.h"
+
+void TranslatorA11R::emitOpcode(u8 opcode)
+{
+    m_function->code.writeByte(opcode);
+    m_lastDefinition = NO_DEFINITION;
+}
+
+u32 TranslatorA11R::emitRegister(u32 cell)
+{
+    u32 offset = m_function->code.size();
+    u16 index = cell;
+    m_function->code.write(&index, 2);
+    return offset;
+}
+
+void TranslatorA11R::emitLabel(std::string_view label)
+{
+    Fixup fixup;
+    fixup.offset = m_function->code.size();
+    fixup.label = label;
+    m_fixups.push_back(fixup);
+
+    u32 pc = 0;
+    m_function->code.write(&pc, 4);
+}
+
+void TranslatorA11R::emitMove(u8 width, u32 dst, u32 src)
+{
+    emitOpcode(width == 4 ? ROP_MOV4 : ROP_MOV8);
+    u32 definition = emitRegister(dst);
+    emitRegister(src);
+    m_lastDefinition = definition;
+}
+
+void TranslatorA11R::emitConstant(u8 width, u32 dst, u64 constant)
+{
+    emitOpcode(width == 4 ? OP_PUSH4 : OP_PUSH8);
+    u32 definition = emitRegister(dst);
+    m_function->code.write(&constant, width);
+    m_lastDefinition = definition;
+}
+
+void TranslatorA11R::reset(i32 height)
+{
+    m_stack.clear();
+    m_height = m_frame->low;
+    while(m_height < height) push(own(4, NO_DEFINITION));
+}
+
+void TranslatorA11R::push(Value value)
+{
+    value.height = m_height;
+    m_stack.push_back(value);
+    m_height += value.width;
+}
+
+TranslatorA11R::Value TranslatorA11R::pop(u32 width)
+{
+    Value top = m_stack.back();
+    if(top.width == width)
+    {
+        m_stack.pop_back();
+        m_height -= width;
+        return top;
+    }
+
+    i32 bottom = m_height - width;
+    while(m_height > bottom)
+    {
+        materialize(&m_stack.back());
+        m_height -= m_stack.back().width;
+        m_stack.pop_back();
+    }
+    while(m_height < bottom) push(own(4, NO_DEFINITION));
+
+    Value value = own(width, NO_DEFINITION);
+    value.height = bottom;
+    return value;
+}
+
+void TranslatorA11R::materialize(Value* value)
+{
+    if(value->kind == VALUE_OWN) return;
+    u32 cell = cellAt(value->height);
+    if(value->kind == VALUE_CONSTANT) emitConstant(value->width, cell, value->constant);
+    else emitMove(value->width, cell, value->cell);
+    value->kind = VALUE_OWN;
+    value->definition = m_lastDefinition;
+}
+
+void TranslatorA11R::materializeAll()
+{
+    for(std::vector<Value>::iterator i = m_stack.begin(); i != m_stack.end(); i++)
+        materialize(&*i);
+}
+
+bool TranslatorA11R::materializeAliases(u32 cell, u32 cells)
+{
+    bool isMaterialized = false;
+    for(std::vector<Value>::iterator i = m_stack.begin(); i != m_stack.end(); i++)
+        if(i->kind == VALUE_CELL && i->cell < cell + cells && cell < i->cell + i->width / 4)
+        {
+            materialize(&*i);
+            isMaterialized = true;
+        }
+    return isMaterialized;
+}
+
+u32 TranslatorA11R::registerFor(Value* value)
+{
+    if(value->kind == VALUE_CONSTANT) materialize(value);
+    return value->kind == VALUE_OWN ? cellAt(value->height) : value->cell;
+}
+
+void TranslatorA11R::define(u8 width, u32 definition)
+{
+    push(own(width, definition));
+    m_lastDefinition = definition;
+}
+
+void TranslatorA11R::swap(u8 topWidth, u8 bottomWidth)
+{
+    Value top = pop(topWidth);
+    Value bottom = pop(bottomWidth);
+
+    u32 lowCell = cellAt(m_height);
+    u32 highCell = cellAt(m_height + topWidth + bottomWidth);
+    auto isMovable = [&](const Value& value)
+    {
+        return value.kind == VALUE_CONSTANT
+            || (value.kind == VALUE_CELL && (value.cell + value.width / 4 <= lowCell || value.cell >= highCell));
+    };
+
+    bool isTopMoved = !isMovable(top);
+    bool isBottomMoved = !isMovable(bottom);
+    if(isTopMoved)
+    {
+        emitMove(topWidth, highCell, registerFor(&top));
+        top.kind = VALUE_CELL;
+        top.cell = highCell;
+    }
+    if(isBottomMoved)
+    {
+        emitMove(bottomWidth, highCell + topWidth / 4, registerFor(&bottom));
+        bottom.kind = VALUE_CELL;
+        bottom.cell = highCell + topWidth / 4;
+    }
+
+    push(top);
+    push(bottom);
+    if(isTopMoved) materialize(&m_stack[m_stack.size() - 2]);
+    if(isBottomMoved) materialize(&m_stack.back());
+}
+
+void TranslatorA11R::invoke(u8 opcode, u32 id, i32 argumentBytes, i32 resultBytes)
+{
+    materializeAll();
+    if(argumentBytes) pop(argumentBytes);
+
+    emitOpcode(opcode);
+    m_function->code.write(&id, 4);
+    emitRegister(cellAt(m_height));
+
+    if(resultBytes < 0) m_isReachable = false;
+    else for(i32 i = 0; i < resultBytes; i += 4) push(own(4, NO_DEFINITION));
+}
+
+void TranslatorA11R::translateOperation(const OperationA11& operation)
+{
+    const InstructionA11* instruction = operation.instruction;
+    u8 opcode = instruction->opcode;
+    Emitter& code = m_function->code;
+
+    ShapeA11 shape;
+    if(VerifierA11::getShape(opcode, &shape))
+    {
+        Value right;
+        if(shape.operandc == 2) right = pop(shape.operandWidth);
+        Value left = pop(shape.operandWidth);
+        u32 leftRegister = registerFor(&left);
+        u32 rightRegister = shape.operandc == 2 ? registerFor(&right) : 0;
+
+        emitOpcode(opcode);
+        u32 definition = emitRegister(cellAt(m_height));
+        emitRegister(leftRegister);
+        if(shape.operandc == 2) emitRegister(rightRegister);
+        define(shape.resultWidth, definition);
+        return;
+    }
+
+    switch(opcode)
+    {
+    case OP_NOP: break;
+    case OP_PUSH4:
+    case OP_PUSH8:
+    {
+        Value value;
+        value.kind = VALUE_CONSTANT;
+        value.width = opcode == OP_PUSH4 ? 4 : 8;
+        value.cell = 0;
+        value.constant = operation.immediate;
+        value.definition = NO_DEFINITION;
+        if(!operation.isImmediate) value.constant = localCellFor(operation.operand.substr(1), false, 0) * 4;
+        push(value);
+        break;
+    }
+    case OP_POP4: pop(4); break;
+    case OP_POP8: pop(8); break;
+    case OP_LOAD4:
+    case OP_LOAD8:
+    {
+        u8 size = instruction->varSize;
+        Value value = pop(size);
+        u32 cell = localCellFor(operation.operand, true, size);
+        bool isRetargetable = value.kind == VALUE_OWN && value.definition != NO_DEFINITION
+                           && value.definition == m_lastDefinition;
+        if(materializeAliases(cell, size / 4)) isRetargetable = false;
+
+        if(isRetargetable)
+        {
+            u16 index = cell;
+            code.patch(value.definition, &index, 2);
+            m_lastDefinition = NO_DEFINITION;
+        }
+        else if(value.kind == VALUE_CONSTANT) emitConstant(size, cell, value.constant);
+        else
+        {
+            u32 src = registerFor(&value);
+            if(src != cell) emitMove(size, cell, src);
+        }
+        break;
+    }
+    case OP_FETCH4:
+    case OP_FETCH8:
+    {
+        Value value;
+        value.kind = VALUE_CELL;
+        value.width = instruction->varSize;
+        value.cell = localCellFor(operation.operand, false, 0);
+        value.constant = 0;
+        value.definition = NO_DEFINITION;
+        push(value);
+        break;
+    }
+    case OP_LOADWIDE4:
+    case OP_LOADWIDE8:
+    {
+        u8 size = instruction->varSize;
+        Value value = pop(size);
+        u32 src = registerFor(&value);
+        u32 mpos = gvarMPosFor(operation.operand, true, size);
+        emitOpcode(opcode);
+        code.write(&mpos, 4);
+        emitRegister(src);
+        break;
+    }
+    case OP_FETCHWIDE4:
+    case OP_FETCHWIDE8:
+    {
+        u32 mpos = gvarMPosFor(operation.operand, false, 0);
+        emitOpcode(opcode);
+        u32 definition = emitRegister(cellAt(m_height));
+        code.write(&mpos, 4);
+        define(instruction->varSize, definition);
+        break;
+    }
+    case OP_VARPTR:
+    {
+        u32 cell = localCellFor(operation.operand, false, 0);
+        emitOpcode(opcode);
+        u32 definition = emitRegister(cellAt(m_height));
+        emitRegister(cell);
+        define(8, definition);
+        break;
+    }
+    case OP_VARPTRWIDE:
+    {
+        u32 mpos = gvarMPosFor(operation.operand, false, 0);
+        emitOpcode(opcode);
+        u32 definition = emitRegister(cellAt(m_height));
+        code.write(&mpos, 4);
+        define(8, definition);
+        break;
+    }
+    case OP_ALLOC:
+    case OP_REFL1:
+    case OP_REFL2:
+    case OP_REFL4:
+    case OP_REFL8:
+    {
+        Value value = pop(8);
+        u32 src = registerFor(&value);
+        emitOpcode(opcode);
+        u32 definition = emitRegister(cellAt(m_height));
+        emitRegister(src);
+        define(opcode == OP_ALLOC || opcode == OP_REFL8 ? 8 : 4, definition);
+        break;
+    }
+    case OP_FREE:
+    {
+        Value value = pop(8);
+        u32 src = registerFor(&value);
+        emitOpcode(opcode);
+        emitRegister(src);
+        break;
+    }
+    case OP_EXTR1:
+    case OP_EXTR2:
+    case OP_EXTR4:
+    case OP_EXTR8:
+    {
+        Value value = pop(opcode == OP_EXTR8 ? 8 : 4);
+        Value pointer = pop(8);
+        u32 src = registerFor(&value);
+        u32 dst = registerFor(&pointer);
+        materializeAliases(m_localBase, REGISTER_LIMIT);
+        emitOpcode(opcode);
+        emitRegister(dst);
+        emitRegister(src);
+        break;
+    }
+    case OP_SWAP4: swap(4, 4); break;
+    case OP_SWAP8: swap(8, 8); break;
+    case OP_SWAP48: swap(8, 4); break;
+    case OP_SWAP84: swap(4, 8); break;
+    case OP_DUP4:
+    case OP_DUP8:
+    {
+        Value value = pop(opcode == OP_DUP4 ? 4 : 8);
+        push(value);
+        if(value.kind == VALUE_OWN)
+        {
+            value.kind = VALUE_CELL;
+            value.cell = cellAt(value.height);
+        }
+        push(value);
+        break;
+    }
+    case OP_GOTO:
+        materializeAll();
+        emitOpcode(opcode);
+        emitLabel(operation.operand);
+        m_isReachable = false;
+        break;
+    case OP_IF:
+    case OP_IFN:
+    {
+        Value condition = pop(4);
+        materializeAll();
+        u32 src = registerFor(&condition);
+        emitOpcode(opcode);
+        emitRegister(src);
+        emitLabel(operation.operand);
+        break;
+    }
+    case OP_CALL:
+    {
+        u32 id = functionIDFor(operation.operand);
+        const FrameA11& callee = m_verifier.getFrame(id);
+        invoke(opcode, id, -callee.low, callee.hasEffect ? callee.effect - callee.low : -1);
+        break;
+    }
+    case OP_NATIVE:
+    {
+        u32 id = nativeIDFor(operation.operand);
+        const NativeData& native = m_natives[id];
+        invoke(opcode, id, native.argumentBytes, native.resultBytes);
+        break;
+    }
+    case OP_RETURN:
+        materializeAll();
+        emitOpcode(opcode);
+        m_isReachable = false;
+        break;
+    default:
+        m_log->abort("instruction \"" + std::string(instruction->mnemonic) + "\" is not supported by a11r");
+    }
+}
+
+void TranslatorA11R::translateFunction(u32 id)
+{
+    FunctionData& function = m_functions[id];
+    m_function = &function;
+    m_frame = &m_verifier.getFrame(id);
+    m_localBase = (m_frame->high - m_frame->low + REGISTER_SCRATCH) / 4;
+    m_localCells = 0;
+    m_locals.clear();
+    m_labelPCs.clear();
+    m_fixups.clear();
+    m_lastDefinition = NO_DEFINITION;
+    m_isReachable = true;
+    reset(0);
+
+    const OperationsA11& operations = function.operations;
+    for(u32 i = 0; i < operations.size(); i++)
+    {
+        const OperationA11& operation = operations[i];
+        i32 height = m_verifier.getHeight(id, i);
+
+        if(operation.isLabel())
+        {
+            if(height == HEIGHT_UNKNOWN) continue;
+            if(m_isReachable) materializeAll();
+            m_labelPCs.set(operation.operand, function.code.size());
+            reset(height);
+            m_isReachable = true;
+            m_lastDefinition = NO_DEFINITION;
+            continue;
+        }
+
+        switch(operation.instruction->operand)
+        {
+        case OPERAND_LVAR_DEF: localCellFor(operation.operand, true, operation.instruction->varSize); break;
+        case OPERAND_GVAR_DEF: gvarMPosFor(operation.operand, true, operation.instruction->varSize); break;
+        default: break;
+        }
+
+        if(operation.isDeclaration || height == HEIGHT_UNKNOWN || !m_isReachable) continue;
+        translateOperation(operation);
+    }
+
+    if(m_isReachable)
+    {
+        materializeAll();
+        emitOpcode(OP_RETURN);
+    }
+
+    for(std::vector<Fixup>::iterator i = m_fixups.begin(); i != m_fixups.end(); i++)
+    {
+        u32* pc = m_labelPCs.find(i->label);
+        if(!pc) m_log->abort("label \"" + std::string(i->label) + "\" not found");
+        function.code.patch(i->offset, pc, 4);
+    }
+
+    u32 frameCells = m_localBase + m_localCells;
+    if(frameCells >= REGISTER_LIMIT)
+        m_log->abort("function \"" + function.name + "\" needs more than " + std::to_string(REGISTER_LIMIT) + " registers");
+    function.frameCells = frameCells;
+}
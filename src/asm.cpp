@@ -21,25 +21,51 @@
  * 
  */
 
+#include <cerrno>
+#include <csignal>
 #include <cstdlib>
+#include <cstring>
 
 #include <iostream>
 #include <fstream>
-
+#include <sstream>
+
+#include <chrono>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 #include "log.h"
+#include "assembler.h"
+#include "cache.h"
+#include "emitter.h"
+#include "profile.h"
+#include "server.h"
+#include "thread_pool.h"
 
 #include "scanner.h"
 #include "a10/scanner.h"
+#include "a10/scanner_mapped.h"
 
 #include "translator.h"
 #include "a10/translator.h"
 #include "a11/translator.h"
+#include "a11r/translator.h"
 
 #define AASM_VERSION                "aasm v1.0"
-#define SUPPORTED_STANDARDS         { "a10", "a11", "" }
+#define SUPPORTED_STANDARDS         { "a10", "a11", "a11r", "" }
 #define DEFAULT_STANDARD            "a11"
+#define DEFAULT_CACHE_SIZE          256
+#define SERVER_PRUNE_INTERVAL       60
 
 struct AssemblerJob
 {
@@ -62,7 +88,92 @@ struct AssemblerJob
     }
 };
 
-std::vector<AssemblerJob> jobs;
+struct AssemblerOptions
+{
+    bool onePass;
+    bool optimize;
+    bool compact;
+    bool layout;
+    bool verify;
+    bool indexed;
+    unsigned int functionThreadc;
+
+    AssemblyCache* cache;
+    std::string cacheSalt;
+
+    const OpcodeProfile* profile;
+
+    AssemblerOptions(): onePass(false), optimize(false), compact(false), layout(false), verify(false), indexed(false), functionThreadc(1), cache(0), profile(0) {}
+};
+
+class AssemblerSession
+{
+public:
+    AssemblerSession(unsigned int pruneInterval): m_pruneInterval(pruneInterval) {}
+
+    const OpcodeProfile* getProfile(Log* log, std::string const& path)
+    {
+        std::error_code error;
+        std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<std::string, Profile>::iterator i = m_profiles.find(path);
+        if(i != m_profiles.end() && !error && i->second.time == time) return i->second.profile.get();
+
+        std::unique_ptr<OpcodeProfile> profile(new OpcodeProfile(log));
+        profile->load(path);
+        Profile& entry = m_profiles[path];
+        entry.time = time;
+        entry.profile.reset(profile.release());
+        return entry.profile.get();
+    }
+
+    AssemblyCache* getCache(std::string const& directory, u64 sizeLimit)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string key = directory + "/" + std::to_string(sizeLimit);
+        std::unordered_map<std::string, Cache>::iterator i = m_caches.find(key);
+        if(i != m_caches.end()) return i->second.cache.get();
+
+        Cache& entry = m_caches[key];
+        entry.cache.reset(new AssemblyCache(directory, sizeLimit));
+        return entry.cache.get();
+    }
+
+    void prune(AssemblyCache* cache)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for(std::unordered_map<std::string, Cache>::iterator i = m_caches.begin(); i != m_caches.end(); i++)
+        {
+            if(i->second.cache.get() != cache) continue;
+            if(i->second.isPruned && now - i->second.pruned < std::chrono::seconds(m_pruneInterval)) return;
+            cache->prune();
+            i->second.isPruned = true;
+            i->second.pruned = now;
+        }
+    }
+private:
+    struct Profile
+    {
+        std::filesystem::file_time_type time;
+        std::unique_ptr<OpcodeProfile> profile;
+    };
+
+    struct Cache
+    {
+        std::unique_ptr<AssemblyCache> cache;
+        std::chrono::steady_clock::time_point pruned;
+        bool isPruned;
+
+        Cache(): isPruned(false) {}
+    };
+
+    unsigned int m_pruneInterval;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Profile> m_profiles;
+    std::unordered_map<std::string, Cache> m_caches;
+};
 
 bool startsWith(std::string const& str, std::string const& beginning)
 {
@@ -78,12 +189,18 @@ bool endsWith(std::string const& str, std::string const& ending)
     return false;
 }
 
-std::string nextArgument(Log* log, int* index, int argc, char** argv)
+std::string nextArgument(Log* log, unsigned int* index, std::vector<std::string> const& args)
 {
     (*index)++;
-    if((*index) >= argc)
-        log->abort("expected argument after " + std::string(argv[*index - 1]));
-    return std::string(argv[*index]);
+    if((*index) >= args.size())
+        log->abort("expected argument after " + args[*index - 1]);
+    return args[*index];
+}
+
+std::string resolvePath(std::string const& directory, std::string const& path)
+{
+    if(directory == "" || path == "" || path == "-" || path[0] == '/') return path;
+    return directory + "/" + path;
 }
 
 std::string genOutputPath(Log* log, std::string sourcePath)
@@ -107,85 +224,339 @@ std::string genOutputPath(Log* log, std::string sourcePath)
     return outputPath;
 }
 
-void displayVersion()
+void displayVersion(std::ostream& out)
 {
-    std::cout << AASM_VERSION << "\n";
+    out << AASM_VERSION << "\n";
 }
 
-void displayHelp()
+void displayHelp(std::ostream& out)
 {
-    std::cout << "Usage: aasm [<option> | <file>]+\n";
-    std::cout << "Options:\n";
-    std::cout << "  --help             Display this information\n";
-    std::cout << "  --version          Display assembler version\n";
-    std::cout << "  --std-support      Display a list of supported standards\n";
-    std::cout << "  --std-default      Display the default standard\n";
-    std::cout << "  -std<standard>     Assume that the input sources are for <standard>\n";
-    std::cout << "                     If <standard> is 'def', the default standard will be used.\n";
-    std::cout << "  -q                 Disable assembler output\n";
-    std::cout << "  -qw                Disable assembler warnings\n";
-    std::cout << "  -o <file>          Manually set the output file for the next job to <file>\n";
-    std::cout << "\n";
+    out << "Usage: aasm [<option> | <file>]+\n";
+    out << "Options:\n";
+    out << "  --help             Display this information\n";
+    out << "  --version          Display assembler version\n";
+    out << "  --std-support      Display a list of supported standards\n";
+    out << "  --std-default      Display the default standard\n";
+    out << "  --server <socket>  Keep running and assemble jobs sent by aasm-client over the Unix socket <socket>\n";
+    out << "  -std<standard>     Assume that the input sources are for <standard>\n";
+    out << "                     If <standard> is 'def', the default standard will be used.\n";
+    out << "  -q                 Disable assembler output\n";
+    out << "  -qw                Disable assembler warnings\n";
+    out << "  -o <file>          Manually set the output file for the next job to <file>, '-' for standard output\n";
+    out << "  -onepass           Read each source only once, backpatching forward references\n";
+    out << "  -O                 Optimize A11 bytecode\n";
+    out << "  -compact           Use variable-length A11 operands and short branches\n";
+    out << "  -layout            Align A11 variables and order them by access count\n";
+    out << "  -verify            Check A11 stack heights and operand widths, and record frame sizes\n";
+    out << "  -indexed           Write A11 bytecode with a function table and page-aligned code for lazy loading\n";
+    out << "  -profile <file>    Fuse the hottest opcode sequences listed in <file> into superinstructions\n";
+    out << "  -j <n>             Assemble up to <n> jobs in parallel, 0 for one per core\n";
+    out << "  -jf <n>            Encode the functions of each source on <n> threads, 0 for one per core\n";
+    out << "  -cache <dir>       Reuse previously assembled files and functions stored in <dir>\n";
+    out << "  -cachesize <mb>    Limit the cache directory to <mb> megabytes (default " << DEFAULT_CACHE_SIZE << ")\n";
+    out << "\n";
+    out << "A <file> of '-' is read from standard input and written to standard output.\n";
+    out << "With -onepass, A11 sources are assembled while they are read instead of being buffered first.\n";
 }
 
-void displaySupportedStandards()
+void displaySupportedStandards(std::ostream& out)
 {
     std::string supportedStandards[] = SUPPORTED_STANDARDS;
-    std::cout << "supported standards: ";
+    out << "supported standards: ";
 
     if(supportedStandards[0] == "")
     {
-        std::cout << "none\n";
+        out << "none\n";
         return;
     }
 
     int index = 0;
     while(true)
     {
-        std::cout << supportedStandards[index];
+        out << supportedStandards[index];
         index++;
         if(supportedStandards[index] == "")
             break;
-        std::cout << ", ";
+        out << ", ";
     }
-    std::cout << "\n";
+    out << "\n";
 }
 
-void displayDefaultStandard()
+void displayDefaultStandard(std::ostream& out)
 {
-    std::cout << "stddef=" << DEFAULT_STANDARD << "\n";
+    out << "stddef=" << DEFAULT_STANDARD << "\n";
 }
 
-int main(int argc, char** argv)
+void translate(Log* log, AssemblerJob const& job, Scanner* scanner, std::ifstream* in, Emitter* emitter, AssemblerOptions const& options)
 {
-    Log* log = new Log();
-    log->setStream(&std::cout, Log::INFO);
-    log->setStream(&std::cout, Log::WARNING);
-    log->setStream(&std::cerr, Log::ERROR);
+    static thread_local std::unique_ptr<Translator> translators[STANDARDC];
+    AssemblerStandard standard = job.standard == "a10" ? STANDARD_A10 : job.standard == "a11" ? STANDARD_A11 : STANDARD_A11R;
+    std::unique_ptr<Translator> translator(std::move(translators[standard]));
+    if(!translator || !translator->reset(log, scanner, emitter))
+    {
+        if(standard == STANDARD_A10) translator.reset(new TranslatorA10(log, scanner, emitter));
+        if(standard == STANDARD_A11) translator.reset(new TranslatorA11(log, scanner, emitter));
+        if(standard == STANDARD_A11R) translator.reset(new TranslatorA11R(log, scanner, emitter));
+    }
+
+    TranslatorOptions translatorOptions;
+    translatorOptions.threadc = options.functionThreadc ? options.functionThreadc : ThreadPool::defaultThreadCount();
+    translatorOptions.cache = options.cache;
+    translatorOptions.cacheSalt = options.cacheSalt;
+    translatorOptions.profile = options.profile;
+    translatorOptions.optimize = options.optimize;
+    translatorOptions.compact = options.compact;
+    translatorOptions.layout = options.layout;
+    translatorOptions.verify = options.verify;
+    translatorOptions.indexed = options.indexed;
+    translator->setOptions(translatorOptions);
+
+    if(options.onePass && !translator->hasSinglePass())
+        log->warning("standard \"" + job.standard + "\" does not support single pass assembly");
+
+    if(options.onePass && translator->hasSinglePass())
+        translator->singlePass();
+    else
+    {
+        translator->labelPass();
 
+        if(scanner->hasBuffer()) scanner->setPosition(0);
+        else
+        {
+            in->close();
+            in->open(job.source.c_str(), std::ios::in);
+            if(!in->good())
+            {
+                log->log(" - failed\n", Log::INFO);
+                log->abort("file not found \"" + job.source + "\"");
+            }
+        }
+
+        translator->translationPass();
+    }
+
+    translators[standard] = std::move(translator);
+}
+
+void assemble(Log* log, AssemblerJob job, AssemblerOptions const& options, std::istream* standardInput, std::ostream* standardOutput)
+{
+    log->log("job: " + job.toString(), Log::INFO);
+
+    if(job.source == job.output && job.source != "-")
+    {
+        log->log(" - failed\n", Log::INFO);
+        log->abort("source and output paths can not be equal");
+    }
+
+    bool isStandardValid = job.standard == "a10" || job.standard == "a11" || job.standard == "a11r";
+    if(!isStandardValid)
+    {
+        log->log(" - failed\n", Log::INFO);
+        log->abort("invalid standard \"" + job.standard + "\"");
+    }
+
+    std::ifstream in;
+    std::ofstream out;
+    static thread_local Emitter emitter;
+    emitter.clear();
+
+    bool isStreamed = options.onePass && job.standard == "a11";
+    std::string bufferedSource;
+    std::unique_ptr<Scanner> scanner;
+    MappedScannerA10* mappedScanner = 0;
+    if(job.source == "-")
+    {
+        if(isStreamed) scanner.reset(new ScannerA10(log, standardInput));
+        else
+        {
+            bufferedSource.assign(std::istreambuf_iterator<char>(*standardInput), std::istreambuf_iterator<char>());
+            scanner.reset(new Scanner(log, bufferedSource.data(), bufferedSource.data() + bufferedSource.size()));
+        }
+    }
+    else
+    {
+        mappedScanner = new MappedScannerA10(log, job.source);
+        if(mappedScanner->isOpen()) scanner.reset(mappedScanner);
+        else
+        {
+            delete mappedScanner;
+            mappedScanner = 0;
+
+            in.open(job.source.c_str(), std::ios::in);
+            if(!in.good())
+            {
+                log->log(" - failed\n", Log::INFO);
+                log->abort("file not found \"" + job.source + "\"");
+            }
+
+            std::error_code error;
+            if(isStreamed || std::filesystem::is_regular_file(job.source, error)) scanner.reset(new ScannerA10(log, &in));
+            else
+            {
+                bufferedSource.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                scanner.reset(new Scanner(log, bufferedSource.data(), bufferedSource.data() + bufferedSource.size()));
+            }
+        }
+    }
+
+    bool isCacheable = options.cache && scanner->hasBuffer();
+    bool isCached = false;
+    CacheKey key;
+    if(isCacheable)
+    {
+        const char* source = scanner->getBufferBegin();
+        key = AssemblyCache::hash(options.cacheSalt + job.standard, source, scanner->getBufferEnd() - source);
+
+        CacheEntry entry;
+        isCached = options.cache->load(key, &entry);
+        if(isCached)
+        {
+            options.cache->countHit(AssemblyCache::FILE);
+            emitter.write(entry.code.data(), entry.code.size());
+        }
+        else options.cache->countMiss(AssemblyCache::FILE);
+    }
+
+    if(!isCached)
+    {
+        translate(log, job, scanner.get(), &in, &emitter, options);
+        if(isCacheable) options.cache->store(key, emitter.data(), emitter.size());
+    }
+
+    in.close();
+
+    if(job.output == "-")
+    {
+        if(!emitter.flush(standardOutput) || !standardOutput->flush())
+        {
+            log->log(" - failed\n", Log::INFO);
+            log->abort("couldn't write to standard output");
+        }
+        log->log(isCached ? " - cached\n" : " - done\n", Log::INFO);
+        return;
+    }
+
+    out.open(job.output.c_str(), std::ios::out | std::ios::binary);
+    if(!emitter.flush(&out))
+    {
+        log->log(" - failed\n", Log::INFO);
+        log->abort("couldn't write \"" + job.output + "\"");
+    }
+    out.close();
+
+    log->log(isCached ? " - cached\n" : " - done\n", Log::INFO);
+}
+
+struct JobResult
+{
+    std::ostringstream out;
+    std::ostringstream err;
+    bool isFailed;
+    bool isDone;
+
+    JobResult(): isFailed(false), isDone(false) {}
+};
+
+int assembleParallel(Log* log, std::vector<AssemblerJob> const& jobs, unsigned int threadc, AssemblerOptions const& options, std::istream* standardInput, std::ostream* standardOutput)
+{
+    std::vector<JobResult> results(jobs.size());
+    std::mutex mutex;
+    std::condition_variable jobDone;
+
+    ThreadPool pool(threadc);
+    for(unsigned int jobi = 0; jobi < jobs.size(); jobi++)
+        pool.submit([&, jobi]
+        {
+            JobResult& result = results[jobi];
+
+            Log jobLog;
+            jobLog.setStream(&result.out, Log::INFO);
+            jobLog.setStream(&result.out, Log::WARNING);
+            jobLog.setStream(&result.err, Log::ERROR);
+            for(int level = 0; level < Log::LEVELC; level++)
+                jobLog.setMuted(log->isMuted((Log::Level) level), (Log::Level) level);
+            jobLog.setAbortThrows(true);
+
+            bool isFailed = false;
+            try
+            {
+                assemble(&jobLog, jobs[jobi], options, standardInput, standardOutput);
+            }
+            catch(LogAbort&)
+            {
+                isFailed = true;
+            }
+            catch(std::exception& e)
+            {
+                jobLog.log(" - failed\n", Log::INFO);
+                jobLog.error(e.what());
+                isFailed = true;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            result.isFailed = isFailed;
+            result.isDone = true;
+            jobDone.notify_all();
+        });
+
+    int status = EXIT_SUCCESS;
+    for(unsigned int jobi = 0; jobi < jobs.size(); jobi++)
+    {
+        JobResult& result = results[jobi];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobDone.wait(lock, [&result] { return result.isDone; });
+        }
+
+        log->log(result.out.str(), Log::INFO);
+        log->log(result.err.str(), Log::ERROR);
+        if(result.isFailed) status = EXIT_FAILURE;
+    }
+    return status;
+}
+
+int runAssembler(Log* log, std::vector<std::string> const& args, std::string const& directory, AssemblerSession* session, std::istream* standardInput, std::ostream* standardOutput)
+{
+    std::vector<AssemblerJob> jobs;
     std::string amlStandard = DEFAULT_STANDARD;
     std::string outputPath = "";
+    AssemblerOptions options;
+    unsigned int threadc = 1;
+    std::string cacheDirectory = "";
+    std::string profilePath = "";
+    u64 cacheSize = DEFAULT_CACHE_SIZE;
 
-    if(argc == 1) log->abort("no command options or input files");
+    if(args.empty()) log->abort("no command options or input files");
 
-    for(int argi = 1; argi < argc; argi++)
+    for(unsigned int argi = 0; argi < args.size(); argi++)
     {
-        std::string arg(argv[argi]);
+        std::string arg = args[argi];
         if(startsWith(arg, "--"))
         {
             arg = arg.substr(2);
-            if(arg == "version") displayVersion();
-            else if(arg == "help") displayHelp();
-            else if(arg == "std-support") displaySupportedStandards();
-            else if(arg == "std-default") displayDefaultStandard();
+            if(arg == "version") displayVersion(*standardOutput);
+            else if(arg == "help") displayHelp(*standardOutput);
+            else if(arg == "std-support") displaySupportedStandards(*standardOutput);
+            else if(arg == "std-default") displayDefaultStandard(*standardOutput);
             else log->abort("invalid argument \"--" + arg + "\"");
         }
-        else if(startsWith(arg, "-"))
+        else if(startsWith(arg, "-") && arg != "-")
         {
             arg = arg.substr(1);
             if(arg == "q") log->setMuted(true, Log::INFO);
             else if(arg == "qw") log->setMuted(true, Log::WARNING);
-            else if(arg == "o") outputPath = nextArgument(log, &argi, argc, argv);
+            else if(arg == "o") outputPath = resolvePath(directory, nextArgument(log, &argi, args));
+            else if(arg == "onepass") options.onePass = true;
+            else if(arg == "O") options.optimize = true;
+            else if(arg == "compact") options.compact = true;
+            else if(arg == "layout") options.layout = true;
+            else if(arg == "verify") options.verify = true;
+            else if(arg == "indexed") options.indexed = true;
+            else if(arg == "profile") profilePath = resolvePath(directory, nextArgument(log, &argi, args));
+            else if(arg == "j") threadc = std::atoi(nextArgument(log, &argi, args).c_str());
+            else if(arg == "jf") options.functionThreadc = std::atoi(nextArgument(log, &argi, args).c_str());
+            else if(arg == "cache") cacheDirectory = resolvePath(directory, nextArgument(log, &argi, args));
+            else if(arg == "cachesize") cacheSize = std::atoll(nextArgument(log, &argi, args).c_str());
             else if(startsWith(arg, "std"))
             {
                 amlStandard = arg.substr(3);
@@ -196,8 +567,9 @@ int main(int argc, char** argv)
         }
         else
         {
+            arg = resolvePath(directory, arg);
             std::string usedOutputPath = outputPath;
-            if(outputPath == "") usedOutputPath = genOutputPath(log, arg);
+            if(outputPath == "") usedOutputPath = arg == "-" ? "-" : genOutputPath(log, arg);
             outputPath = "";
 
             AssemblerJob job(arg, usedOutputPath, amlStandard);
@@ -205,68 +577,165 @@ int main(int argc, char** argv)
         }
     }
 
+    unsigned int stdinJobc = 0;
+    unsigned int stdoutJobc = 0;
     for(unsigned int jobi = 0; jobi < jobs.size(); jobi++)
     {
-        AssemblerJob job = jobs[jobi];
-        log->log("job: " + job.toString(), Log::INFO);
+        if(jobs[jobi].source == "-") stdinJobc++;
+        if(jobs[jobi].output == "-") stdoutJobc++;
+    }
+    if(stdinJobc > 1) log->abort("only one job can read standard input");
+    if(stdoutJobc > 1) log->abort("only one job can write standard output");
+    if(stdoutJobc)
+    {
+        log->setStream(log->getStream(Log::ERROR), Log::INFO);
+        log->setStream(log->getStream(Log::ERROR), Log::WARNING);
+    }
 
-        if(job.source == job.output)
+    const OpcodeProfile* profile = 0;
+    if(profilePath != "")
+    {
+        profile = session->getProfile(log, profilePath);
+        options.profile = profile;
+    }
+
+    AssemblyCache* cache = 0;
+    if(cacheDirectory != "")
+    {
+        cache = session->getCache(cacheDirectory, cacheSize * 1024 * 1024);
+        options.cache = cache;
+        options.cacheSalt = std::string(AASM_VERSION) + "/" + std::to_string(CACHE_FORMAT_VERSION) + "/";
+        if(options.optimize) options.cacheSalt += "O/";
+        if(options.compact) options.cacheSalt += "C/";
+        if(options.layout) options.cacheSalt += "L/";
+        if(options.verify) options.cacheSalt += "V/";
+        if(options.indexed) options.cacheSalt += "I/";
+        if(profile)
         {
-            log->log(" - failed\n", Log::INFO);
-            log->abort("source and output paths can not be equal");
+            const std::string& text = profile->getText();
+            options.cacheSalt += AssemblyCache::hash("profile", text.data(), text.size()).toString() + "/";
         }
+    }
 
-        std::ifstream in;
-        std::ofstream out;
-
-        Scanner* scanner = 0;
-        if(job.standard == "a10") scanner = new ScannerA10(log, &in);
-        if(job.standard == "a11") scanner = new ScannerA10(log, &in);
+    int status = EXIT_SUCCESS;
+    if(threadc != 1 && jobs.size() > 1)
+        status = assembleParallel(log, jobs, threadc, options, standardInput, standardOutput);
+    else
+        for(unsigned int jobi = 0; jobi < jobs.size(); jobi++)
+            assemble(log, jobs[jobi], options, standardInput, standardOutput);
 
-        if(!scanner)
-        {
-            log->log(" - failed\n", Log::INFO);
-            log->abort("invalid standard \"" + job.standard + "\"");
-        }
+    if(cache)
+    {
+        session->prune(cache);
+        log->log(cache->getStats() + "\n", Log::INFO);
+    }
 
-        Translator* translator = 0;
-        if(job.standard == "a10") translator = new TranslatorA10(log, scanner, &out);
-        if(job.standard == "a11") translator = new TranslatorA11(log, scanner, &out);
+    return status;
+}
 
-        if(!translator)
-        {
-            log->log(" - failed\n", Log::INFO);
-            log->abort("invalid standard \"" + job.standard + "\"");
-        }
+void serveConnection(int connection, AssemblerSession* session)
+{
+    u32 version = 0;
+    u32 argc = 0;
+    std::string directory;
+    std::string source;
+    if(!receiveAll(connection, &version, 4) || version != SERVER_PROTOCOL_VERSION) return;
+    if(!receiveAll(connection, &argc, 4) || argc > SERVER_ARGUMENT_LIMIT || !receiveString(connection, &directory)) return;
+
+    std::vector<std::string> args(argc);
+    for(u32 i = 0; i < argc; i++)
+        if(!receiveString(connection, &args[i])) return;
+    if(!receiveString(connection, &source)) return;
+
+    std::ostringstream out;
+    std::ostringstream err;
+    std::istringstream input(source);
+    std::ostringstream output;
+
+    Log log;
+    log.setStream(&out, Log::INFO);
+    log.setStream(&out, Log::WARNING);
+    log.setStream(&err, Log::ERROR);
+    log.setAbortThrows(true);
+
+    u32 status = EXIT_FAILURE;
+    try
+    {
+        status = runAssembler(&log, args, directory, session, &input, &output);
+    }
+    catch(LogAbort&)
+    {
+    }
+    catch(std::exception& e)
+    {
+        log.error(e.what());
+    }
 
-        in.open(job.source.c_str(), std::ios::in);
-        out.open(job.output.c_str(), std::ios::out | std::ios::binary);
-        if(!in.good())
-        {
-            log->log(" - failed\n", Log::INFO);
-            log->abort("file not found \"" + job.source + "\"");
-        }
+    if(sendAll(connection, &status, 4) && sendString(connection, out.str()) && sendString(connection, err.str()))
+        sendString(connection, output.str());
+}
 
-        translator->labelPass();
+int serve(Log* log, std::string path)
+{
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0) log->abort("couldn't create server socket");
 
-        in.close();
-        out.close();
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)) log->abort("socket path too long \"" + path + "\"");
+    std::memcpy(address.sun_path, path.c_str(), path.size());
 
-        in.open(job.source.c_str(), std::ios::in);
-        out.open(job.output.c_str(), std::ios::out | std::ios::binary);
-        if(!in.good())
+    struct stat st;
+    if(lstat(path.c_str(), &st) == 0)
+    {
+        if(!S_ISSOCK(st.st_mode)) log->abort("\"" + path + "\" exists and is not a socket");
+        unlink(path.c_str());
+    }
+    if(bind(listener, (sockaddr*) &address, sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0)
+        log->abort("couldn't listen on \"" + path + "\"");
+    signal(SIGPIPE, SIG_IGN);
+    log->info("listening on " + path);
+    log->getStream(Log::INFO)->flush();
+
+    AssemblerSession session(SERVER_PRUNE_INTERVAL);
+    ThreadPool pool(0);
+    while(true)
+    {
+        int connection = accept(listener, 0, 0);
+        if(connection < 0)
         {
-            log->log(" - failed\n", Log::INFO);
-            log->abort("file not found \"" + job.source + "\"");
+            if(errno == EINTR) continue;
+            log->abort("couldn't accept connection");
         }
 
-        translator->translationPass();
+        // A stalled client would otherwise hold a worker forever.
+        timeval timeout = { SERVER_TIMEOUT, 0 };
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
 
-        in.close();
-        out.close();
+        pool.submit([connection, &session]
+        {
+            serveConnection(connection, &session);
+            close(connection);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Log* log = new Log();
+    log->setStream(&std::cout, Log::INFO);
+    log->setStream(&std::cout, Log::WARNING);
+    log->setStream(&std::cerr, Log::ERROR);
 
-        log->log(" - done\n", Log::INFO);
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if(!args.empty() && args[0] == "--server")
+    {
+        if(args.size() != 2) log->abort("expected a socket path after --server");
+        return serve(log, args[1]);
     }
 
-    return EXIT_SUCCESS;
+    AssemblerSession session(0);
+    return runAssembler(log, args, "", &session, &std::cin, &std::cout);
 }
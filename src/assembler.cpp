@@ -0,0 +1,99 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: assembler.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "assembler.h"
+
+#include "a10/translator.h"
+#include "a11/translator.h"
+#include "a11r/translator.h"
+
+Assembler::Assembler()
+{
+    m_log.setStream(&m_diagnostics, Log::INFO);
+    m_log.setStream(&m_diagnostics, Log::WARNING);
+    m_log.setStream(&m_diagnostics, Log::ERROR);
+    m_log.setAbortThrows(true);
+}
+
+Translator* Assembler::prepareTranslator(std::string_view source, AssemblerStandard standard)
+{
+    if(standard < 0 || standard >= STANDARDC) m_log.abort("invalid standard " + std::to_string(standard));
+
+    std::unique_ptr<Scanner> scanner(new Scanner(&m_log, source.data(), source.data() + source.size()));
+    std::unique_ptr<Translator>& translator = m_translators[standard];
+    if(!translator || !translator->reset(&m_log, scanner.get(), &m_emitter))
+    {
+        switch(standard)
+        {
+        case STANDARD_A10: translator.reset(new TranslatorA10(&m_log, scanner.get(), &m_emitter)); break;
+        case STANDARD_A11: translator.reset(new TranslatorA11(&m_log, scanner.get(), &m_emitter)); break;
+        case STANDARD_A11R: translator.reset(new TranslatorA11R(&m_log, scanner.get(), &m_emitter)); break;
+        default: break;
+        }
+    }
+    m_scanners[standard].reset(scanner.release());
+
+    translator->setOptions(m_options);
+    return translator.get();
+}
+
+AssemblerResult Assembler::assemble(std::string_view source, AssemblerStandard standard)
+{
+    AssemblerResult result;
+    result.isSuccess = true;
+    m_diagnostics.str("");
+    m_emitter.clear();
+
+    try
+    {
+        Translator* translator = prepareTranslator(source, standard);
+        if(translator->hasSinglePass()) translator->singlePass();
+        else
+        {
+            translator->labelPass();
+            m_scanners[standard]->setPosition(0);
+            translator->translationPass();
+        }
+        result.bytes.assign(m_emitter.data(), m_emitter.data() + m_emitter.size());
+    }
+    catch(LogAbort&)
+    {
+        result.isSuccess = false;
+    }
+    catch(std::exception& e)
+    {
+        m_log.error(e.what());
+        result.isSuccess = false;
+    }
+
+    if(!result.isSuccess && standard >= 0 && standard < STANDARDC)
+        m_translators[standard].reset();
+    result.diagnostics = m_diagnostics.str();
+    return result;
+}
+
+AssemblerResult assemble(std::string_view source, AssemblerStandard standard)
+{
+    static thread_local Assembler assembler;
+    return assembler.assemble(source, standard);
+}
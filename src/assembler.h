@@ -0,0 +1,82 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: assembler.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef ASSEMBLER_H_
+#define ASSEMBLER_H_
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+#include "emitter.h"
+#include "log.h"
+#include "scanner.h"
+#include "translator.h"
+
+enum AssemblerStandard
+{
+    STANDARD_A10,
+    STANDARD_A11,
+    STANDARD_A11R,
+
+    STANDARDC
+};
+
+struct AssemblerResult
+{
+    bool isSuccess;
+    std::vector<u8> bytes;
+    std::string diagnostics;
+};
+
+class Assembler
+{
+public:
+    Assembler();
+    ~Assembler() {}
+
+    void setOptimize(bool optimize) { m_options.optimize = optimize; }
+    void setCompact(bool compact) { m_options.compact = compact; }
+    void setLayout(bool layout) { m_options.layout = layout; }
+    void setVerify(bool verify) { m_options.verify = verify; }
+    void setIndexed(bool indexed) { m_options.indexed = indexed; }
+
+    AssemblerResult assemble(std::string_view source, AssemblerStandard standard);
+private:
+    Log m_log;
+    std::ostringstream m_diagnostics;
+    Emitter m_emitter;
+    std::unique_ptr<Scanner> m_scanners[STANDARDC];
+    std::unique_ptr<Translator> m_translators[STANDARDC];
+
+    TranslatorOptions m_options;
+
+    Translator* prepareTranslator(std::string_view source, AssemblerStandard standard);
+};
+
+AssemblerResult assemble(std::string_view source, AssemblerStandard standard);
+
+#endif /* ASSEMBLER_H_ */
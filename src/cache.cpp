@@ -0,0 +1,267 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: cache.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include "cache.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+#define CACHE_MAGIC             "AAC"
+
+static inline u64 mixBits(u64 x)
+{
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static u64 hashBytes(const void* data, size_t size, u64 seed)
+{
+    const u8* bytes = static_cast<const u8*>(data);
+    u64 hash = seed ^ (size * 0x9E3779B97F4A7C15ull);
+    for(; size >= 8; bytes += 8, size -= 8)
+    {
+        u64 word;
+        std::memcpy(&word, bytes, 8);
+        hash = (hash ^ mixBits(word)) * 0x9E3779B97F4A7C15ull;
+        hash = (hash << 27) | (hash >> 37);
+    }
+
+    u64 tail = 0;
+    std::memcpy(&tail, bytes, size);
+    hash ^= mixBits(tail ^ size);
+    return mixBits(hash);
+}
+
+std::string CacheKey::toString() const
+{
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "%016llx%016llx", (unsigned long long) high, (unsigned long long) low);
+    return std::string(buffer);
+}
+
+AssemblyCache::AssemblyCache(std::string directory, u64 sizeLimit)
+: m_directory(directory), m_sizeLimit(sizeLimit), m_stores(0), m_evictions(0)
+{
+    for(int i = 0; i < KINDC; i++)
+    {
+        m_hits[i] = 0;
+        m_misses[i] = 0;
+    }
+}
+
+CacheKey AssemblyCache::hash(std::string_view salt, const void* data, size_t size)
+{
+    CacheKey key;
+    key.high = hashBytes(data, size, hashBytes(salt.data(), salt.size(), 0x243F6A8885A308D3ull));
+    key.low = hashBytes(data, size, hashBytes(salt.data(), salt.size(), 0x13198A2E03707344ull));
+    return key;
+}
+
+std::string AssemblyCache::pathFor(CacheKey const& key)
+{
+    std::string name = key.toString();
+    return m_directory + "/" + name.substr(0, 2) + "/" + name.substr(2);
+}
+
+template<typename T>
+static inline bool readValue(std::string const& data, size_t* offset, T* value)
+{
+    if(*offset + sizeof(T) > data.size()) return false;
+    std::memcpy(value, data.data() + *offset, sizeof(T));
+    *offset += sizeof(T);
+    return true;
+}
+
+template<typename T>
+static inline void writeValue(std::string* data, T value)
+{
+    data->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+bool AssemblyCache::load(CacheKey const& key, CacheEntry* entry)
+{
+    std::string path = pathFor(key);
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    if(!in.good()) return false;
+
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    size_t offset = 4;
+    if(data.size() < offset || data.compare(0, 3, CACHE_MAGIC) != 0 || (u8) data[3] != CACHE_FORMAT_VERSION)
+        return false;
+
+    u32 size;
+    if(!readValue(data, &offset, &size) || offset + size > data.size()) return false;
+    entry->code.assign(data.begin() + offset, data.begin() + offset + size);
+    offset += size;
+
+    u32 referencec;
+    if(!readValue(data, &offset, &referencec)) return false;
+    entry->references.clear();
+    for(u32 i = 0; i < referencec; i++)
+    {
+        CacheReference reference;
+        u16 length;
+        if(!readValue(data, &offset, &reference.kind)) return false;
+        if(!readValue(data, &offset, &reference.size)) return false;
+        if(!readValue(data, &offset, &reference.value)) return false;
+        if(!readValue(data, &offset, &length) || offset + length > data.size()) return false;
+        reference.name.assign(data, offset, length);
+        offset += length;
+        entry->references.push_back(reference);
+    }
+
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
+
+void AssemblyCache::store(CacheKey const& key, const void* code, size_t size, std::vector<CacheReference> const& references)
+{
+    std::string data(CACHE_MAGIC);
+    data.push_back((char) CACHE_FORMAT_VERSION);
+    writeValue<u32>(&data, size);
+    data.append(static_cast<const char*>(code), size);
+    writeValue<u32>(&data, references.size());
+    for(std::vector<CacheReference>::const_iterator i = references.begin(); i != references.end(); i++)
+    {
+        writeValue<u8>(&data, i->kind);
+        writeValue<u8>(&data, i->size);
+        writeValue<u32>(&data, i->value);
+        writeValue<u16>(&data, i->name.size());
+        data.append(i->name);
+    }
+
+    std::string path = pathFor(key);
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    if(error) return;
+
+    std::ostringstream temporary;
+    temporary << path << ".tmp" << getpid() << "." << std::this_thread::get_id();
+    std::ofstream out(temporary.str().c_str(), std::ios::out | std::ios::binary);
+    out.write(data.data(), data.size());
+    out.close();
+    if(!out.good())
+    {
+        std::filesystem::remove(temporary.str(), error);
+        return;
+    }
+
+    std::filesystem::rename(temporary.str(), path, error);
+    if(error) std::filesystem::remove(temporary.str(), error);
+    else m_stores++;
+}
+
+void AssemblyCache::store(CacheKey const& key, const void* code, size_t size)
+{
+    store(key, code, size, std::vector<CacheReference>());
+}
+
+struct CacheFile
+{
+    std::filesystem::file_time_type time;
+    u64 size;
+    std::filesystem::path path;
+};
+
+static bool isHexName(std::string const& name, size_t length)
+{
+    if(name.size() != length) return false;
+    for(char c: name)
+    {
+        if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    }
+    return true;
+}
+
+static bool hasEntryMagic(std::filesystem::path const& path)
+{
+    char magic[3];
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0;
+}
+
+void AssemblyCache::prune()
+{
+    std::vector<CacheFile> files;
+    u64 total = 0;
+
+    std::error_code error;
+    std::filesystem::directory_iterator i(m_directory, error), end;
+    for(; !error && i != end; i.increment(error))
+    {
+        std::error_code entryError;
+        if(i->is_symlink(entryError) || !i->is_directory(entryError)) continue;
+        if(!isHexName(i->path().filename().string(), 2)) continue;
+
+        std::filesystem::directory_iterator j(i->path(), entryError);
+        for(; !entryError && j != end; j.increment(entryError))
+        {
+            std::error_code fileError;
+            if(j->is_symlink(fileError) || !j->is_regular_file(fileError)) continue;
+            if(!isHexName(j->path().filename().string(), 30) || !hasEntryMagic(j->path())) continue;
+
+            CacheFile file;
+            file.path = j->path();
+            file.size = j->file_size(fileError);
+            file.time = j->last_write_time(fileError);
+            if(fileError) continue;
+            total += file.size;
+            files.push_back(file);
+        }
+    }
+
+    if(total <= m_sizeLimit) return;
+
+    std::sort(files.begin(), files.end(), [](CacheFile const& a, CacheFile const& b) { return a.time < b.time; });
+    for(std::vector<CacheFile>::iterator file = files.begin(); file != files.end() && total > m_sizeLimit; file++)
+    {
+        if(!std::filesystem::remove(file->path, error)) continue;
+        total -= file->size;
+        m_evictions++;
+    }
+}
+
+std::string AssemblyCache::getStats()
+{
+    std::ostringstream stats;
+    stats << "cache: files " << m_hits[FILE] << " hit / " << m_misses[FILE] << " miss, ";
+    stats << "functions " << m_hits[FUNCTION] << " hit / " << m_misses[FUNCTION] << " miss, ";
+    stats << m_stores << " stored, " << m_evictions << " evicted";
+    return stats.str();
+}
@@ -0,0 +1,94 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: cache.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+
+#define CACHE_FORMAT_VERSION    2
+
+struct CacheKey
+{
+    u64 high;
+    u64 low;
+
+    std::string toString() const;
+};
+
+struct CacheReference
+{
+    u8 kind;
+    u8 size;
+    u32 value;
+    std::string name;
+};
+
+struct CacheEntry
+{
+    std::vector<u8> code;
+    std::vector<CacheReference> references;
+};
+
+class AssemblyCache
+{
+public:
+    enum Kind
+    {
+        FILE,
+        FUNCTION,
+
+        KINDC
+    };
+
+    AssemblyCache(std::string directory, u64 sizeLimit);
+
+    static CacheKey hash(std::string_view salt, const void* data, size_t size);
+
+    bool load(CacheKey const& key, CacheEntry* entry);
+    void store(CacheKey const& key, const void* code, size_t size, std::vector<CacheReference> const& references);
+    void store(CacheKey const& key, const void* code, size_t size);
+
+    inline void countHit(Kind kind) { m_hits[kind]++; }
+    inline void countMiss(Kind kind) { m_misses[kind]++; }
+
+    void prune();
+    std::string getStats();
+private:
+    std::string m_directory;
+    u64 m_sizeLimit;
+
+    std::atomic<u64> m_hits[KINDC];
+    std::atomic<u64> m_misses[KINDC];
+    std::atomic<u64> m_stores;
+    std::atomic<u64> m_evictions;
+
+    std::string pathFor(CacheKey const& key);
+};
+
+#endif /* CACHE_H_ */
@@ -0,0 +1,101 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: client.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "server.h"
+
+void displayHelp()
+{
+    std::cout << "Usage: aasm-client <socket> [<option> | <file>]+\n";
+    std::cout << "Sends the aasm command line to a server started with 'aasm --server <socket>'\n";
+    std::cout << "and prints its output. Relative paths are resolved against the current directory,\n";
+    std::cout << "and a <file> of '-' sends standard input along with the request.\n";
+}
+
+int main(int argc, char** argv)
+{
+    Log* log = new Log();
+    log->setStream(&std::cout, Log::INFO);
+    log->setStream(&std::cout, Log::WARNING);
+    log->setStream(&std::cerr, Log::ERROR);
+
+    if(argc < 2) log->abort("no server socket");
+    std::string path(argv[1]);
+    if(path == "--help") { displayHelp(); return 0; }
+
+    std::vector<std::string> args(argv + 2, argv + argc);
+    std::string source;
+    for(unsigned int i = 0; i < args.size(); i++)
+        if(args[i] == "-" && (i == 0 || args[i - 1] != "-o"))
+        {
+            source.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+            break;
+        }
+
+    if(source.size() > SERVER_MESSAGE_LIMIT) log->abort("standard input is too large to send to the server");
+    if(args.size() > SERVER_ARGUMENT_LIMIT) log->abort("too many arguments to send to the server");
+
+    char directory[4096];
+    if(!getcwd(directory, sizeof(directory))) log->abort("couldn't read the working directory");
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)) log->abort("socket path too long \"" + path + "\"");
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(connection < 0 || connect(connection, (sockaddr*) &address, sizeof(address)) < 0)
+        log->abort("couldn't connect to \"" + path + "\"");
+
+    u32 version = SERVER_PROTOCOL_VERSION;
+    u32 argCount = args.size();
+    bool isSent = sendAll(connection, &version, 4) && sendAll(connection, &argCount, 4) && sendString(connection, directory);
+    for(unsigned int i = 0; isSent && i < args.size(); i++)
+        isSent = sendString(connection, args[i]);
+    isSent = isSent && sendString(connection, source);
+
+    u32 status;
+    std::string out, err, output;
+    if(!isSent || !receiveAll(connection, &status, 4) || !receiveString(connection, &out)
+       || !receiveString(connection, &err) || !receiveString(connection, &output))
+        log->abort("lost connection to \"" + path + "\"");
+    close(connection);
+
+    std::cout << out << output;
+    std::cout.flush();
+    std::cerr << err;
+    return status;
+}
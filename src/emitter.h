@@ -0,0 +1,118 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: emitter.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef EMITTER_H_
+#define EMITTER_H_
+
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <new>
+#include <ostream>
+
+#include "common.h"
+
+class Emitter
+{
+public:
+    Emitter(): m_data(0), m_size(0), m_capacity(0) {}
+    Emitter(const Emitter& other): m_data(0), m_size(0), m_capacity(0) { write(other.m_data, other.m_size); }
+    Emitter(Emitter&& other) noexcept: m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity)
+    {
+        other.m_data = 0;
+        other.m_size = 0;
+        other.m_capacity = 0;
+    }
+    ~Emitter() { std::free(m_data); }
+
+    Emitter& operator=(const Emitter& other)
+    {
+        if(this != &other)
+        {
+            clear();
+            write(other.m_data, other.m_size);
+        }
+        return *this;
+    }
+
+    inline u8* data() { return m_data; }
+    inline size_t size() { return m_size; }
+    inline void clear() { m_size = 0; }
+
+    inline void reserve(size_t capacity)
+    {
+        if(capacity <= m_capacity) return;
+        u8* data = static_cast<u8*>(std::realloc(m_data, capacity));
+        if(!data) throw std::bad_alloc();
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    inline void write(const void* ptr, size_t size)
+    {
+        if(m_size + size > m_capacity) reserve(std::max(m_size + size, m_capacity * 2 + 64));
+        std::memcpy(m_data + m_size, ptr, size);
+        m_size += size;
+    }
+
+    inline void writeByte(u8 byte)
+    {
+        if(m_size == m_capacity) reserve(m_capacity * 2 + 64);
+        m_data[m_size++] = byte;
+    }
+
+    inline void writeVarint(u64 value, u32 length)
+    {
+        for(u32 i = 1; i < length; i++)
+        {
+            writeByte((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        writeByte(value & 0x7F);
+    }
+
+    static inline u32 varintSize(u64 value)
+    {
+        u32 size = 1;
+        while(value >>= 7) size++;
+        return size;
+    }
+
+    inline void patch(size_t offset, const void* ptr, size_t size)
+    {
+        std::memcpy(m_data + offset, ptr, size);
+    }
+
+    inline bool flush(std::ostream* out)
+    {
+        out->write(reinterpret_cast<const char*>(m_data), m_size);
+        return out->good();
+    }
+private:
+    u8* m_data;
+    size_t m_size;
+    size_t m_capacity;
+};
+
+#endif /* EMITTER_H_ */
@@ -26,6 +26,15 @@
 
 #include <cstdlib>
 #include <ostream>
+#include <string>
+#include <mutex>
+
+struct LogAbort
+{
+    std::string message;
+
+    LogAbort(std::string message): message(message) {}
+};
 
 class Log
 {
@@ -39,7 +48,7 @@ public:
         LEVELC
     };
 
-    Log() { for(int i = 0; i < LEVELC; i++) m_isMuted[i] = false; }
+    Log(): m_abortThrows(false) { for(int i = 0; i < LEVELC; i++) m_isMuted[i] = false; }
     virtual ~Log() {}
 
     inline std::ostream* getStream(Level level)
@@ -66,20 +75,34 @@ public:
         m_isMuted[level] = muted;
     }
 
+    inline bool isAbortThrowing() { return m_abortThrows; }
+    inline void setAbortThrows(bool abortThrows) { m_abortThrows = abortThrows; }
+
     inline void log(std::string message, Level level)
     {
         levelInBounds(level);
         if(!m_isMuted[level])
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
             *(m_stream[level]) << message;
+        }
     }
 
     inline void info(std::string message) { log(message + "\n", INFO); }
     inline void warning(std::string message) { log(message + "\n", WARNING); }
     inline void error(std::string message) { log(message + "\n", ERROR); }
-    inline void abort(std::string message) { error(message); error("abort"); exit(1); }
+    inline void abort(std::string message)
+    {
+        error(message);
+        error("abort");
+        if(m_abortThrows) throw LogAbort(message);
+        exit(1);
+    }
 private:
     std::ostream* m_stream[LEVELC];
     bool m_isMuted[LEVELC];
+    bool m_abortThrows;
+    std::mutex m_mutex;
 
     inline void levelInBounds(Level level)
     {
@@ -0,0 +1,84 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: profile.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <cstdlib>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "log.h"
+
+class OpcodeProfile
+{
+public:
+    struct Sequence
+    {
+        u64 count;
+        std::vector<u8> opcodes;
+    };
+
+    OpcodeProfile(Log* log): m_log(log) {}
+
+    void load(std::string path)
+    {
+        std::ifstream in(path.c_str(), std::ios::in);
+        if(!in.good()) m_log->abort("couldn't read profile \"" + path + "\"");
+
+        std::string line;
+        for(u32 lineNumber = 1; std::getline(in, line); lineNumber++)
+        {
+            m_text += line + "\n";
+            if(line.empty() || line[0] == '#') continue;
+
+            std::istringstream fields(line);
+            Sequence sequence;
+            std::string field;
+            if(!(fields >> sequence.count))
+                m_log->abort("invalid profile entry at \"" + path + "\":" + std::to_string(lineNumber));
+            while(fields >> field)
+            {
+                char* end;
+                unsigned long opcode = std::strtoul(field.c_str(), &end, 16);
+                if(*end != 0 || opcode > 0xFF)
+                    m_log->abort("invalid opcode \"" + field + "\" in profile \"" + path + "\"");
+                sequence.opcodes.push_back(opcode);
+            }
+            m_sequences.push_back(sequence);
+        }
+    }
+
+    inline const std::vector<Sequence>& getSequences() const { return m_sequences; }
+    inline const std::string& getText() const { return m_text; }
+private:
+    Log* m_log;
+    std::vector<Sequence> m_sequences;
+    std::string m_text;
+};
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,161 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: run.cpp
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "log.h"
+#include "a11/interpreter.h"
+#include "a11/semantics.h"
+
+static void printi4(InterpreterA11* interpreter) { std::printf("%d\n", (i32) interpreter->pop4()); }
+static void printi8(InterpreterA11* interpreter) { std::printf("%lld\n", (long long) (i64) interpreter->pop8()); }
+static void printf4(InterpreterA11* interpreter) { std::printf("%g\n", fromBitsA11<f32>(interpreter->pop4())); }
+static void printf8(InterpreterA11* interpreter) { std::printf("%g\n", fromBitsA11<f64>(interpreter->pop8())); }
+static void printc(InterpreterA11* interpreter) { std::putchar((int) interpreter->pop4()); }
+
+class BytecodeFile
+{
+public:
+    BytecodeFile(): m_data(0), m_size(0), m_isMapped(false) {}
+    ~BytecodeFile()
+    {
+#ifdef __unix__
+        if(m_isMapped) munmap((void*) m_data, m_size);
+#endif
+    }
+
+    bool open(const std::string& path)
+    {
+#ifdef __unix__
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        struct stat status;
+        if(fstat(fd, &status) == 0 && status.st_size > 0)
+        {
+            void* data = mmap(0, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(data != MAP_FAILED)
+            {
+                m_data = (const u8*) data;
+                m_size = status.st_size;
+                m_isMapped = true;
+            }
+        }
+        close(fd);
+        if(m_isMapped) return true;
+#endif
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+        if(!in.good()) return false;
+        m_buffer.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+        return true;
+    }
+
+    inline const u8* data() { return m_data; }
+    inline size_t size() { return m_size; }
+private:
+    const u8* m_data;
+    size_t m_size;
+    bool m_isMapped;
+    std::vector<u8> m_buffer;
+};
+
+void displayHelp()
+{
+    std::cout << "Usage: aasm-run [<option>]* <file>\n";
+    std::cout << "Options:\n";
+    std::cout << "  --help             Display this information\n";
+    std::cout << "  -jit               Compile functions to x86-64 machine code on their first call\n";
+    std::cout << "  -profile <file>    Write the executed opcode pairs and triples to <file> for aasm -profile\n";
+    std::cout << "\n";
+    std::cout << "Natives: printi4 printi8 printf4 printf8 printc\n";
+    std::cout << "The exit status is the 4-byte value left on top of the stack when main returns.\n";
+}
+
+int main(int argc, char** argv)
+{
+    Log* log = new Log();
+    log->setStream(&std::cout, Log::INFO);
+    log->setStream(&std::cout, Log::WARNING);
+    log->setStream(&std::cerr, Log::ERROR);
+
+    std::string path = "";
+    std::string profilePath = "";
+    bool jit = false;
+
+    if(argc == 1) log->abort("no command options or input files");
+
+    for(int argi = 1; argi < argc; argi++)
+    {
+        std::string arg(argv[argi]);
+        if(arg == "--help") { displayHelp(); return 0; }
+        else if(arg == "-jit") jit = true;
+        else if(arg == "-profile")
+        {
+            if(++argi >= argc) log->abort("missing argument for \"-profile\"");
+            profilePath = argv[argi];
+        }
+        else if(arg[0] == '-') log->abort("invalid argument \"" + arg + "\"");
+        else if(path != "") log->abort("only one bytecode file can be run");
+        else path = arg;
+    }
+    if(path == "") log->abort("no input file");
+
+    BytecodeFile bytecode;
+    if(!bytecode.open(path)) log->abort("couldn't read \"" + path + "\"");
+
+    InterpreterA11 interpreter(log);
+    interpreter.registerNative("printi4", printi4);
+    interpreter.registerNative("printi8", printi8);
+    interpreter.registerNative("printf4", printf4);
+    interpreter.registerNative("printf8", printf8);
+    interpreter.registerNative("printc", printc);
+    interpreter.load(bytecode.data(), bytecode.size());
+    interpreter.setProfiling(profilePath != "");
+    if(jit && profilePath != "") log->warning("-profile interprets every function, ignoring -jit");
+    else interpreter.setJit(jit);
+
+    i32 status = interpreter.run();
+    std::fflush(stdout);
+
+    if(profilePath != "")
+    {
+        std::ofstream out(profilePath.c_str(), std::ios::out);
+        if(!out.good()) log->abort("couldn't write profile \"" + profilePath + "\"");
+        interpreter.writeProfile(out);
+    }
+    return status;
+}
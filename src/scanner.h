@@ -25,29 +25,66 @@
 #define SCANNER_H_
 
 #include <istream>
+#include <string>
+#include <string_view>
 
+#include "common.h"
 #include "log.h"
 
 class Scanner
 {
 public:
     Scanner(Log* log, std::istream* in)
-    : m_log(log), m_in(in) {}
+    : m_log(log), m_in(in), m_begin(0), m_cursor(0), m_end(0) {}
+    Scanner(Log* log, const char* begin, const char* end)
+    : m_log(log), m_in(0), m_begin(begin), m_cursor(begin), m_end(end) {}
     virtual ~Scanner() {}
 
-    virtual std::string getToken() { return ""; }
-    virtual bool nextToken() { return false; }
+    virtual std::string getToken() { return std::string(m_token); }
+    virtual bool nextToken() { return scanBuffer(); }
 
-    inline void nextTokenEOF()
+    virtual u64 getPosition() { return m_cursor - m_begin; }
+    virtual void setPosition(u64 position) { m_cursor = m_begin + position; }
+
+    inline bool hasBuffer() { return m_begin != 0; }
+    inline const char* getBufferBegin() { return m_begin; }
+    inline const char* getBufferEnd() { return m_end; }
+
+    inline std::string_view token() { return m_token; }
+
+    inline bool advance()
     {
-        if(!nextToken())
-            m_log->abort("EOF not expected after " + getToken());
+        if(m_begin) return scanBuffer();
+        return nextToken();
     }
 
-    inline std::istream* getIn() { return m_in; }
+    inline void nextTokenEOF()
+    {
+        if(!advance())
+            m_log->abort("EOF not expected after " + std::string(m_token));
+    }
 protected:
     Log* m_log;
     std::istream* m_in;
+
+    const char* m_begin;
+    const char* m_cursor;
+    const char* m_end;
+    std::string_view m_token;
+
+    static inline bool isSpace(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    inline bool scanBuffer()
+    {
+        while(m_cursor < m_end && isSpace(*m_cursor)) m_cursor++;
+        const char* start = m_cursor;
+        while(m_cursor < m_end && !isSpace(*m_cursor)) m_cursor++;
+        m_token = std::string_view(start, m_cursor - start);
+        return m_cursor != start;
+    }
 };
 
 #endif /* SCANNER_H_ */
@@ -0,0 +1,98 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: server.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <algorithm>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "common.h"
+
+#define SERVER_PROTOCOL_VERSION     1
+#define SERVER_MESSAGE_LIMIT        (256u << 20)
+#define SERVER_ARGUMENT_LIMIT       4096
+#define SERVER_RECEIVE_CHUNK        (64u << 10)
+#define SERVER_TIMEOUT              30
+
+// A request is the protocol version, the argument count, the client's working
+// directory, the arguments and the standard input, each string prefixed by its
+// u32 length. The reply is the u32 exit status, the info and error log and the
+// standard output. Strings longer than SERVER_MESSAGE_LIMIT and requests with
+// more than SERVER_ARGUMENT_LIMIT arguments are rejected. Strings are received
+// in chunks of SERVER_RECEIVE_CHUNK bytes, so a declared length only costs
+// memory once its bytes arrive. The server drops connections that stall for
+// SERVER_TIMEOUT seconds.
+
+inline bool sendAll(int socket, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while(size)
+    {
+        ssize_t sent = send(socket, bytes, size, 0);
+        if(sent <= 0) return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+inline bool receiveAll(int socket, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while(size)
+    {
+        ssize_t received = recv(socket, bytes, size, 0);
+        if(received <= 0) return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+inline bool sendString(int socket, const std::string& value)
+{
+    if(value.size() > SERVER_MESSAGE_LIMIT) return false;
+    u32 size = value.size();
+    return sendAll(socket, &size, 4) && sendAll(socket, value.data(), size);
+}
+
+inline bool receiveString(int socket, std::string* value)
+{
+    u32 size;
+    if(!receiveAll(socket, &size, 4) || size > SERVER_MESSAGE_LIMIT) return false;
+    value->clear();
+    while(value->size() < size)
+    {
+        size_t offset = value->size();
+        size_t chunk = std::min<size_t>(size - offset, SERVER_RECEIVE_CHUNK);
+        value->resize(offset + chunk);
+        if(!receiveAll(socket, &(*value)[offset], chunk)) return false;
+    }
+    return true;
+}
+
+#endif /* SERVER_H_ */
@@ -0,0 +1,191 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: symbol_table.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef SYMBOL_TABLE_H_
+#define SYMBOL_TABLE_H_
+
+#include <cstdlib>
+#include <cstring>
+
+#include <new>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+
+class StringArena
+{
+public:
+    StringArena(): m_chunki(0), m_used(0) {}
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    ~StringArena()
+    {
+        for(unsigned int i = 0; i < m_chunks.size(); i++)
+            std::free(m_chunks[i].data);
+    }
+
+    inline std::string_view store(std::string_view str)
+    {
+        if(m_chunki >= m_chunks.size() || m_used + str.size() > m_chunks[m_chunki].size)
+            nextChunk(str.size());
+        char* data = m_chunks[m_chunki].data + m_used;
+        std::memcpy(data, str.data(), str.size());
+        m_used += str.size();
+        return std::string_view(data, str.size());
+    }
+
+    inline void clear()
+    {
+        m_chunki = 0;
+        m_used = 0;
+    }
+private:
+    struct Chunk
+    {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Chunk> m_chunks;
+    unsigned int m_chunki;
+    size_t m_used;
+
+    void nextChunk(size_t minimum)
+    {
+        if(m_chunki < m_chunks.size() && m_used > 0) m_chunki++;
+        while(m_chunki < m_chunks.size() && m_chunks[m_chunki].size < minimum) m_chunki++;
+        m_used = 0;
+        if(m_chunki < m_chunks.size()) return;
+
+        Chunk chunk;
+        chunk.size = minimum > 65536 ? minimum : 65536;
+        chunk.data = static_cast<char*>(std::malloc(chunk.size));
+        if(!chunk.data) throw std::bad_alloc();
+        m_chunks.push_back(chunk);
+        m_chunki = m_chunks.size() - 1;
+    }
+};
+
+class SymbolTable
+{
+public:
+    SymbolTable(): m_slots(16, 0) {}
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    inline u32 size() { return m_entries.size(); }
+    inline std::string_view getName(u32 symbol) { return m_entries[symbol].name; }
+    inline u32 getScope(u32 symbol) { return m_entries[symbol].scope; }
+    inline u32 getValue(u32 symbol) { return m_entries[symbol].value; }
+
+    inline u32* find(std::string_view name, u32 scope = 0)
+    {
+        u32 hash = hashSymbol(name, scope);
+        u32 mask = m_slots.size() - 1;
+        for(u32 slot = hash & mask; m_slots[slot]; slot = (slot + 1) & mask)
+        {
+            Entry& entry = m_entries[m_slots[slot] - 1];
+            if(entry.hash == hash && entry.scope == scope && entry.name == name)
+                return &entry.value;
+        }
+        return 0;
+    }
+
+    inline u32 set(std::string_view name, u32 value, u32 scope = 0)
+    {
+        u32 hash = hashSymbol(name, scope);
+        u32 mask = m_slots.size() - 1;
+        u32 slot = hash & mask;
+        for(; m_slots[slot]; slot = (slot + 1) & mask)
+        {
+            Entry& entry = m_entries[m_slots[slot] - 1];
+            if(entry.hash == hash && entry.scope == scope && entry.name == name)
+            {
+                entry.value = value;
+                return m_slots[slot] - 1;
+            }
+        }
+
+        Entry entry;
+        entry.name = m_names.store(name);
+        entry.scope = scope;
+        entry.value = value;
+        entry.hash = hash;
+        entry.slot = slot;
+        m_entries.push_back(entry);
+        m_slots[slot] = m_entries.size();
+
+        if(m_entries.size() * 2 > m_slots.size()) grow();
+        return m_entries.size() - 1;
+    }
+
+    inline void clear()
+    {
+        for(unsigned int i = 0; i < m_entries.size(); i++)
+            m_slots[m_entries[i].slot] = 0;
+        m_entries.clear();
+        m_names.clear();
+    }
+private:
+    struct Entry
+    {
+        std::string_view name;
+        u32 scope;
+        u32 value;
+        u32 hash;
+        u32 slot;
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<u32> m_slots;
+    StringArena m_names;
+
+    static inline u32 hashSymbol(std::string_view name, u32 scope)
+    {
+        u32 hash = 2166136261u ^ (scope * 0x9E3779B9u);
+        for(size_t i = 0; i < name.size(); i++)
+        {
+            hash ^= (u8) name[i];
+            hash *= 16777619u;
+        }
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    void grow()
+    {
+        m_slots.assign(m_slots.size() * 2, 0);
+        u32 mask = m_slots.size() - 1;
+        for(unsigned int i = 0; i < m_entries.size(); i++)
+        {
+            u32 slot = m_entries[i].hash & mask;
+            while(m_slots[slot]) slot = (slot + 1) & mask;
+            m_slots[slot] = i + 1;
+            m_entries[i].slot = slot;
+        }
+    }
+};
+
+#endif /* SYMBOL_TABLE_H_ */
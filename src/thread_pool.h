@@ -0,0 +1,109 @@
+/* 
+ * Copyright (C) 2014 Lovro Kalinovcic
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * File: thread_pool.h
+ * Description: 
+ * Author: Lovro Kalinovcic
+ * 
+ */
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    ThreadPool(unsigned int threadc): m_pending(0), m_isStopping(false)
+    {
+        if(threadc == 0) threadc = defaultThreadCount();
+        for(unsigned int i = 0; i < threadc; i++)
+            m_threads.push_back(std::thread(&ThreadPool::work, this));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isStopping = true;
+        }
+        m_taskAvailable.notify_all();
+        for(unsigned int i = 0; i < m_threads.size(); i++)
+            m_threads[i].join();
+    }
+
+    static inline unsigned int defaultThreadCount()
+    {
+        unsigned int threadc = std::thread::hardware_concurrency();
+        return threadc ? threadc : 1;
+    }
+
+    inline unsigned int getThreadCount() { return m_threads.size(); }
+
+    inline void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(task);
+            m_pending++;
+        }
+        m_taskAvailable.notify_one();
+    }
+
+    inline void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_allDone.wait(lock, [this] { return m_pending == 0; });
+    }
+private:
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()> > m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_allDone;
+    unsigned int m_pending;
+    bool m_isStopping;
+
+    void work()
+    {
+        while(true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_taskAvailable.wait(lock, [this] { return m_isStopping || !m_tasks.empty(); });
+                if(m_tasks.empty()) return;
+                task = m_tasks.front();
+                m_tasks.pop_front();
+            }
+
+            task();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending--;
+            if(m_pending == 0) m_allDone.notify_all();
+        }
+    }
+};
+
+#endif /* THREAD_POOL_H_ */
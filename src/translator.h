@@ -24,23 +24,71 @@
 #ifndef TRANSLATOR_H_
 #define TRANSLATOR_H_
 
-#include <ostream>
+#include <cstdlib>
+#include <cstring>
 
+#include <string>
+#include <string_view>
+
+#include "cache.h"
+#include "emitter.h"
+#include "profile.h"
 #include "scanner.h"
 
+// Settings that an assembler passes to every translator it runs. Standards
+// ignore the options they do not implement.
+struct TranslatorOptions
+{
+    unsigned int threadc;
+    AssemblyCache* cache;
+    std::string cacheSalt;
+    const OpcodeProfile* profile;
+    bool optimize;
+    bool compact;
+    bool layout;
+    bool verify;
+    bool indexed;
+
+    TranslatorOptions(): threadc(1), cache(0), profile(0), optimize(false), compact(false), layout(false), verify(false), indexed(false) {}
+};
+
 class Translator
 {
 public:
-    Translator(Log* log, Scanner* scanner, std::ostream* out)
+    Translator(Log* log, Scanner* scanner, Emitter* out)
     : m_log(log), m_scanner(scanner), m_out(out) {}
     virtual ~Translator() {}
 
     virtual void labelPass() {}
     virtual void translationPass() {}
+
+    virtual bool hasSinglePass() { return false; }
+    virtual void singlePass() {}
+
+    virtual bool reset(Log*, Scanner*, Emitter*) { return false; }
+    virtual void setOptions(TranslatorOptions const&) {}
 protected:
     Log* m_log;
     Scanner* m_scanner;
-    std::ostream* m_out;
+    Emitter* m_out;
+
+    static inline i64 parseInteger(std::string_view token)
+    {
+        char buffer[64];
+        if(token.size() >= sizeof(buffer)) return std::atoll(std::string(token).c_str());
+        std::memcpy(buffer, token.data(), token.size());
+        buffer[token.size()] = 0;
+        return std::atoll(buffer);
+    }
+
+    static inline f64 parseFloat(std::string_view token)
+    {
+        char buffer[64];
+        if(token.size() >= sizeof(buffer)) return std::atof(std::string(token).c_str());
+        std::memcpy(buffer, token.data(), token.size());
+        buffer[token.size()] = 0;
+        return std::atof(buffer);
+    }
 };
 
 #endif /* TRANSLATOR_H_ */
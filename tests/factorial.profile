@@ -0,0 +1,3 @@
+# count opcodes...
+1000 18 18
+500 18 08
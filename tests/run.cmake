@@ -0,0 +1,30 @@
+# Assembles SOURCE with the space-separated assembler FLAGS, runs the result
+# with aasm-run and its RUN_FLAGS, and compares standard output to EXPECTED.
+# Sources assembled with -cache are assembled twice, so the second run is
+# served from the cache.
+
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+separate_arguments(run_flags UNIX_COMMAND "${RUN_FLAGS}")
+
+set(passes 1)
+if(FLAGS MATCHES "-cache")
+    set(passes 2)
+endif()
+
+foreach(pass RANGE 1 ${passes})
+    file(REMOVE ${OUTPUT})
+    execute_process(COMMAND ${AASM} -q ${flags} -o ${OUTPUT} ${SOURCE} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "aasm ${FLAGS} failed on ${SOURCE}")
+    endif()
+endforeach()
+
+execute_process(COMMAND ${AASM_RUN} ${run_flags} ${OUTPUT} OUTPUT_VARIABLE output RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "aasm-run ${RUN_FLAGS} exited with ${result}")
+endif()
+
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "aasm ${FLAGS}, aasm-run ${RUN_FLAGS}: expected\n${expected}got\n${output}")
+endif()
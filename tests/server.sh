@@ -0,0 +1,24 @@
+#!/bin/sh
+# Usage: server.sh <aasm> <aasm-client> <aasm-run> <source> <expected> <work dir>
+# Assembles the source twice through one aasm server and runs both results.
+
+aasm=$1 client=$2 run=$3 source=$4 expected=$5 work=$6
+socket=$work/aasm-test.sock
+mkdir -p "$work"
+rm -f "$socket"
+
+"$aasm" --server "$socket" > /dev/null &
+server=$!
+trap 'kill $server 2> /dev/null' EXIT
+
+tries=0
+while [ ! -S "$socket" ]; do
+    tries=$((tries + 1))
+    [ $tries -gt 50 ] && exit 1
+    sleep 0.1
+done
+
+for flags in "-O -verify" ""; do
+    "$client" "$socket" -q $flags -o "$work/server.aby" "$source" || exit 1
+    "$run" "$work/server.aby" | cmp -s - "$expected" || exit 1
+done